@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    The startup code for ValuePropertyWndBenchmarks, the console build of the
+    benchmarks and the unit tests. It makes no windows, so it runs without a
+    display; see Benchmarks/CMakeLists.txt for how it's built.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TableLoadBenchmark.h"
+#include "DataPathBenchmark.h"
+#include "RenderBenchmark.h"
+#include "UnsavedEditsTest.h"
+
+static UnsavedEditsTest unsavedEditsTest;
+
+//==============================================================================
+/** Prints a benchmark's JSON result, or writes it to the file given with --output. */
+static void writeBenchmarkResult (const juce::var& result, const juce::StringArray& arguments)
+{
+    auto json = juce::JSON::toString (result);
+
+    if (auto index = arguments.indexOf ("--output"); index >= 0)
+        juce::File::getCurrentWorkingDirectory().getChildFile (arguments[index + 1].unquoted()).replaceWithText (json);
+    else
+        std::cout << json << std::endl;
+}
+
+static int printUsage()
+{
+    std::cerr << "Usage: ValuePropertyWndBenchmarks --benchmark-load <file>" << std::endl
+              << "       ValuePropertyWndBenchmarks --benchmark-data | --benchmark-render [options] [--output <file>]" << std::endl
+              << "       ValuePropertyWndBenchmarks --run-tests" << std::endl
+              << "See DataPathBenchmark.h and RenderBenchmark.h for the options." << std::endl;
+    return 1;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const juce::StringArray arguments (argv + 1, argc - 1);
+
+    // sets up fonts and the message loop as the app has them, none of which needs a display
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    if (arguments.contains ("--run-tests"))
+    {
+        juce::UnitTestRunner runner;
+        runner.setAssertOnFailure (false);
+        runner.runAllTests();
+
+        for (int i = 0; i < runner.getNumResults(); ++i)
+            if (runner.getResult (i)->failures > 0)
+                return 1;
+
+        return 0;
+    }
+
+    if (auto index = arguments.indexOf ("--benchmark-load"); index >= 0)
+    {
+        if (index + 1 >= arguments.size())
+            return printUsage();
+
+        auto tableFile = juce::File::getCurrentWorkingDirectory().getChildFile (arguments[index + 1].unquoted());
+        std::cout << TableLoadBenchmark::run (tableFile) << std::flush;
+        return 0;
+    }
+
+    if (arguments.contains ("--benchmark-data"))
+    {
+        auto result = DataPathBenchmark::runWithArguments (arguments);
+        writeBenchmarkResult (result, arguments);
+        return result.hasProperty ("error") ? 1 : 0;
+    }
+
+    if (arguments.contains ("--benchmark-render"))
+    {
+        // the table paints into an Image rather than a window, but the load and the
+        // benchmark's timer still need the message loop running
+        auto exitCode = 0;
+
+        RenderBenchmark benchmark (arguments, [&] (const juce::var& result)
+        {
+            writeBenchmarkResult (result, arguments);
+            exitCode = result.hasProperty ("error") ? 1 : 0;
+            juce::MessageManager::getInstance()->stopDispatchLoop();
+        });
+
+        juce::MessageManager::getInstance()->runDispatchLoop();
+        return exitCode;
+    }
+
+    return printUsage();
+}
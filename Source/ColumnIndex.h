@@ -0,0 +1,174 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableViewOrder.h"
+//==============================================================================
+/**
+    Every store row of one column, in the order DataSorter sorts them by that column.
+
+    Because rows with the same value sit next to each other, the rows that are equal
+    to, less than or greater than some value can be found with a binary search. As
+    the order is exactly the column's ascending sort, it can also be shown as the
+    sorted view of the column without sorting again.
+
+    The index isn't told how to compare anything: findRows() is given a function
+    that compares a row's value with the one being looked for, and insertRow() one
+    that says which of two rows comes first. An edited row is found by a binary search
+    on its old value with findPosition(), and then moved to the place for its new one
+    with moveRow().
+*/
+class ColumnIndex
+{
+public:
+    enum class Comparison
+    {
+        equal,
+        notEqual,
+        less,
+        lessOrEqual,
+        greater,
+        greaterOrEqual
+    };
+
+    /** Takes a list of every store row, sorted by DataSorter. */
+    explicit ColumnIndex (std::vector<int> sortedRows)
+        : rows (std::make_shared<std::vector<int>> (std::move (sortedRows)))
+    {}
+
+    int getNumRows() const noexcept                     { return (int) rows->size(); }
+
+    /** Returns the rows in ascending order, to be shown as a sorted view. */
+    TableViewOrder::RowList getSortedRows() const       { return rows; }
+
+    /** Returns the store rows whose value compares with some value in a given way, in
+        ascending order of store row. compareWithValue (row) must return a negative
+        number, zero or a positive number if the row's value is less than, equal to or
+        greater than the value being looked for.
+    */
+    template <typename CompareFunction>
+    std::vector<int> findRows (Comparison comparison, CompareFunction&& compareWithValue) const
+    {
+        auto first = rows->begin(), last = rows->end();
+        auto firstEqual = std::partition_point (first, last, [&] (int row) { return compareWithValue (row) < 0; });
+        auto firstGreater = std::partition_point (firstEqual, last, [&] (int row) { return compareWithValue (row) <= 0; });
+
+        // the matching rows are one or two runs of the sorted rows, which get put back
+        // into store order by marking them and sweeping over the marks
+        std::vector<bool> isMatch (rows->size());
+        size_t numMatches = 0;
+
+        auto markRange = [&] (std::vector<int>::const_iterator start, std::vector<int>::const_iterator end)
+        {
+            for (auto it = start; it != end; ++it)
+                isMatch[(size_t) *it] = true;
+
+            numMatches += (size_t) (end - start);
+        };
+
+        switch (comparison)
+        {
+            case Comparison::equal:             markRange (firstEqual, firstGreater); break;
+            case Comparison::notEqual:          markRange (first, firstEqual); markRange (firstGreater, last); break;
+            case Comparison::less:              markRange (first, firstEqual); break;
+            case Comparison::lessOrEqual:       markRange (first, firstGreater); break;
+            case Comparison::greater:           markRange (firstGreater, last); break;
+            case Comparison::greaterOrEqual:    markRange (firstEqual, last); break;
+        }
+
+        std::vector<int> matchingRows;
+        matchingRows.reserve (numMatches);
+
+        for (size_t row = 0; row < isMatch.size(); ++row)
+            if (isMatch[row])
+                matchingRows.push_back ((int) row);
+
+        return matchingRows;
+    }
+
+    /** Returns true if the result of comparing a value with another one satisfies a comparison. */
+    static bool satisfies (Comparison comparison, int comparisonResult) noexcept
+    {
+        switch (comparison)
+        {
+            case Comparison::equal:             return comparisonResult == 0;
+            case Comparison::notEqual:          return comparisonResult != 0;
+            case Comparison::less:              return comparisonResult < 0;
+            case Comparison::lessOrEqual:       return comparisonResult <= 0;
+            case Comparison::greater:           return comparisonResult > 0;
+            case Comparison::greaterOrEqual:    return comparisonResult >= 0;
+        }
+
+        return false;
+    }
+
+    /** Parses an operator like "==", ">=" or "!=". A single "=" means equal too. */
+    static std::optional<Comparison> parseComparison (juce::StringRef text)
+    {
+        if (text == "==" || text == "=")    return Comparison::equal;
+        if (text == "!=" || text == "<>")   return Comparison::notEqual;
+        if (text == "<")                    return Comparison::less;
+        if (text == "<=")                   return Comparison::lessOrEqual;
+        if (text == ">")                    return Comparison::greater;
+        if (text == ">=")                   return Comparison::greaterOrEqual;
+
+        return {};
+    }
+
+    //==============================================================================
+    /** Returns where a row is in the order, or -1 if it isn't there. isBefore (a, b) must
+        return true if row a sorts before row b by the values the index was ordered by, so
+        for a row that's being edited it has to compare the row's old value.
+    */
+    template <typename LessThanFunction>
+    int findPosition (int row, LessThanFunction&& isBefore) const
+    {
+        auto position = std::lower_bound (rows->begin(), rows->end(), row, isBefore);
+        return position != rows->end() && *position == row ? (int) (position - rows->begin()) : -1;
+    }
+
+    /** Moves the row at a position found by findPosition() to where it goes now that its
+        value has changed. isBefore (a, b) compares the rows by their values now. Only the
+        rows between the old place and the new one move.
+    */
+    template <typename LessThanFunction>
+    void moveRow (int position, LessThanFunction&& isBefore)
+    {
+        jassert (juce::isPositiveAndBelow (position, getNumRows()));
+
+        auto& sortedRows = getRowsToModify();
+        auto current = sortedRows.begin() + position;
+        const auto row = *current;
+
+        // the other rows are still in order, so the new place is searched for on the side
+        // the row has moved to
+        if (current != sortedRows.begin() && isBefore (row, *(current - 1)))
+            std::rotate (std::lower_bound (sortedRows.begin(), current, row, isBefore), current, current + 1);
+        else
+            std::rotate (current, current + 1, std::lower_bound (current + 1, sortedRows.end(), row, isBefore));
+    }
+
+    /** Puts a new row into the order. isBefore (a, b) must return true if row a sorts
+        before row b, as DataSorter would order them.
+    */
+    template <typename LessThanFunction>
+    void insertRow (int row, LessThanFunction&& isBefore)
+    {
+        auto& sortedRows = getRowsToModify();
+        sortedRows.insert (std::lower_bound (sortedRows.begin(), sortedRows.end(), row, isBefore), row);
+    }
+
+private:
+    std::shared_ptr<std::vector<int>> rows;
+
+    /** The sorted rows may also be shown in the view, which mustn't see them change. Only
+        the first edit after that copies them; the index owns its copy after that.
+    */
+    std::vector<int>& getRowsToModify()
+    {
+        if (rows.use_count() > 1)
+            rows = std::make_shared<std::vector<int>> (*rows);
+
+        return *rows;
+    }
+
+    JUCE_LEAK_DETECTOR (ColumnIndex)
+};
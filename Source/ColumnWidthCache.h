@@ -0,0 +1,159 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    Remembers the width of the widest cell in each column, for one font, so that
+    auto-sizing a column doesn't have to measure every row again.
+
+    Widths are measured in the background once a table has loaded, and kept up to
+    date as cells are edited: an edit that widens a column just raises its width,
+    while one that narrows the widest cell marks the column for measuring again.
+    Every edit bumps the column's version, so a measurement that was started before
+    an edit can be recognised as out of date when it finishes.
+
+    Huge tables are measured on an evenly spaced sample of rows, which makes their
+    widths an estimate until an edit or a re-measure refines them.
+*/
+class ColumnWidthCache
+{
+public:
+    /** The measured width of a column's widest cell, and the row it's in. */
+    struct Measurement
+    {
+        int widest = 0;
+        int widestRow = -1;
+    };
+
+    /** Forgets every width, e.g. because a new table was loaded or the font changed. */
+    void reset (int numColumns, const juce::Font& newFont)
+    {
+        font = newFont;
+        columns.assign ((size_t) numColumns, {});
+    }
+
+    /** Returns the width of the widest cell in a column, or -1 if it hasn't been measured
+        with this font.
+    */
+    int getWidest (int slot, const juce::Font& fontToUse) const
+    {
+        if (! juce::isPositiveAndBelow (slot, (int) columns.size()) || fontToUse != font)
+            return -1;
+
+        auto& column = columns[(size_t) slot];
+        return column.measured ? column.measurement.widest : -1;
+    }
+
+    /** Returns a number that changes whenever a cell in the column is edited. */
+    int getVersion (int slot) const noexcept
+    {
+        return juce::isPositiveAndBelow (slot, (int) columns.size()) ? columns[(size_t) slot].version : 0;
+    }
+
+    /** Stores a measurement that was taken when the column had the given version. Returns
+        false, and ignores it, if the column has been edited since.
+    */
+    bool setMeasurement (int slot, int version, Measurement measurement)
+    {
+        if (! juce::isPositiveAndBelow (slot, (int) columns.size()) || columns[(size_t) slot].version != version)
+            return false;
+
+        auto& column = columns[(size_t) slot];
+        column.measurement = measurement;
+        column.measured = true;
+        return true;
+    }
+
+    /** Takes an edited cell into account. Returns true if the column has to be measured
+        again, because its widest cell got narrower.
+    */
+    bool cellChanged (int slot, int row, int newWidth)
+    {
+        if (! juce::isPositiveAndBelow (slot, (int) columns.size()))
+            return false;
+
+        auto& column = columns[(size_t) slot];
+        ++column.version;
+
+        if (! column.measured)
+            return false;
+
+        if (newWidth >= column.measurement.widest)
+        {
+            column.measurement = { newWidth, row };
+            return false;
+        }
+
+        if (row != column.measurement.widestRow)
+            return false;
+
+        column.measured = false;
+        return true;
+    }
+
+    /** Takes an edit of many cells of a column into account, by forgetting its width
+        so that it gets measured again.
+    */
+    void columnChanged (int slot)
+    {
+        if (! juce::isPositiveAndBelow (slot, (int) columns.size()))
+            return;
+
+        auto& column = columns[(size_t) slot];
+        ++column.version;
+        column.measured = false;
+    }
+
+    //==============================================================================
+    /** Picks the rows to measure in a table: all of them, or an evenly spaced sample of
+        huge tables.
+    */
+    static std::vector<int> chooseRowsToMeasure (int numRows)
+    {
+        const auto step = juce::jmax (1, numRows / maxRowsToMeasure);
+        std::vector<int> rows;
+        rows.reserve ((size_t) (numRows / step + 1));
+
+        for (int row = 0; row < numRows; row += step)
+            rows.push_back (row);
+
+        return rows;
+    }
+
+    /** Finds the widest of some cells, which came from the given rows. Returns an empty
+        measurement if shouldExit() asks it to stop.
+    */
+    static Measurement measure (const std::vector<juce::String>& cells, const std::vector<int>& rows,
+                                const juce::Font& font, const std::function<bool()>& shouldExit = {})
+    {
+        jassert (cells.size() == rows.size());
+        Measurement result;
+
+        for (size_t i = 0; i < cells.size(); ++i)
+        {
+            if ((i & 1023) == 0 && shouldExit != nullptr && shouldExit())
+                return {};
+
+            auto width = font.getStringWidth (cells[i]);
+
+            if (width > result.widest)
+                result = { width, rows[i] };
+        }
+
+        return result;
+    }
+
+private:
+    struct Column
+    {
+        Measurement measurement;
+        bool measured = false;
+        int version = 0;
+    };
+
+    static constexpr int maxRowsToMeasure = 20000;
+
+    juce::Font font { 14.0f };
+    std::vector<Column> columns;
+
+    JUCE_LEAK_DETECTOR (ColumnWidthCache)
+};
@@ -0,0 +1,285 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableRowStore.h"
+#include "TableViewOrder.h"
+#include "DataSorter.h"
+#include "ColumnWidthCache.h"
+#include "SyntheticTable.h"
+//==============================================================================
+/**
+    Measures the data path of the table without showing it: loading a file into a
+    store, sorting by each column, measuring each column for its auto-size width, and
+    reading cells through a view order as painting does. Results come back as a
+    JSON-ready var, so runs of different versions can be compared by a script.
+
+    Run ValuePropertyWndBenchmarks, the console build in Benchmarks, with
+    "--benchmark-data" to benchmark synthetic tables and print the JSON, or see
+    runWithArguments() for the options.
+*/
+class DataPathBenchmark
+{
+public:
+    /** Runs the benchmark that some command-line arguments ask for:
+
+        --table <file>          benchmark an existing table instead of synthetic ones
+        --rows <n,n,...>        the sizes of the synthetic tables (10000,100000,1000000)
+        --cardinality <n>       the number of different Module values (1000)
+        --min-length <n>        the shortest Name and Description (8)
+        --max-length <n>        the longest Name and Description (64)
+        --seed <n>              the generator's seed (1)
+        --runs <n>              the number of loads to take the best of (3)
+    */
+    static juce::var runWithArguments (const juce::StringArray& arguments)
+    {
+        const auto numRuns = juce::jmax (1, getOption (arguments, "--runs", "3").getIntValue());
+        juce::Array<juce::var> results;
+
+        if (auto tablePath = getOption (arguments, "--table", {}); tablePath.isNotEmpty())
+        {
+            results.add (run (juce::File::getCurrentWorkingDirectory().getChildFile (tablePath), numRuns));
+        }
+        else
+        {
+            auto options = getTableOptions (arguments);
+            std::vector<int> rowCounts;
+
+            for (auto& count : juce::StringArray::fromTokens (getOption (arguments, "--rows", "10000,100000,1000000"), ",", {}))
+                if (count.getIntValue() > 0)
+                    rowCounts.push_back (count.getIntValue());
+
+            // the peak memory only ever grows, so the tables go from small to big to give
+            // each size's peak a chance of being its own
+            std::sort (rowCounts.begin(), rowCounts.end());
+
+            for (auto numRows : rowCounts)
+            {
+                options.numRows = numRows;
+                results.add (runSynthetic (options, numRuns));
+            }
+        }
+
+        auto* report = new juce::DynamicObject();
+        report->setProperty ("benchmark", "data-path");
+        report->setProperty ("version", ProjectInfo::versionString);
+        report->setProperty ("juce", juce::SystemStats::getJUCEVersion());
+        report->setProperty ("os", juce::SystemStats::getOperatingSystemName());
+        report->setProperty ("cpus", juce::SystemStats::getNumCpus());
+        report->setProperty ("results", results);
+        return report;
+    }
+
+    /** Returns the value that follows an option in some command-line arguments. */
+    static juce::String getOption (const juce::StringArray& arguments, const char* name, const juce::String& defaultValue)
+    {
+        auto index = arguments.indexOf (name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1].unquoted() : defaultValue;
+    }
+
+    /** Returns the synthetic table options that some command-line arguments ask for. */
+    static SyntheticTable::Options getTableOptions (const juce::StringArray& arguments)
+    {
+        SyntheticTable::Options options;
+        options.numDistinctValues = getOption (arguments, "--cardinality", juce::String (options.numDistinctValues)).getIntValue();
+        options.minTextLength     = getOption (arguments, "--min-length", juce::String (options.minTextLength)).getIntValue();
+        options.maxTextLength     = getOption (arguments, "--max-length", juce::String (options.maxTextLength)).getIntValue();
+        options.seed              = getOption (arguments, "--seed", juce::String (options.seed)).getLargeIntValue();
+        return options;
+    }
+
+    /** Writes a synthetic table to a temporary file and benchmarks it. */
+    static juce::var runSynthetic (const SyntheticTable::Options& options, int numRuns)
+    {
+        juce::TemporaryFile tableFile (".xml");
+
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+        const auto written = SyntheticTable::write (tableFile.getFile(), options);
+        const auto milliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+        auto* generator = new juce::DynamicObject();
+        generator->setProperty ("rows", options.numRows);
+        generator->setProperty ("cardinality", options.numDistinctValues);
+        generator->setProperty ("minLength", options.minTextLength);
+        generator->setProperty ("maxLength", options.maxTextLength);
+        generator->setProperty ("seed", options.seed);
+        generator->setProperty ("milliseconds", milliseconds);
+
+        auto result = written ? run (tableFile.getFile(), numRuns) : makeError ("couldn't write the table");
+        result.getDynamicObject()->setProperty ("generator", generator);
+        return result;
+    }
+
+    /** Loads a table file numRuns times, keeping the best time, and then benchmarks
+        the last store loaded.
+    */
+    static juce::var run (const juce::File& tableFile, int numRuns = 3)
+    {
+        TableRowStore store;
+        auto best = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+        {
+            store.clear();     // so the last run's rows don't add to the peak
+
+            const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+            if (! store.loadFromFile (tableFile))
+                return makeError ("couldn't load " + tableFile.getFullPathName());
+
+            best = juce::jmin (best, juce::Time::getMillisecondCounterHiRes() - startTime);
+        }
+
+        const auto encodeStartTime = juce::Time::getMillisecondCounterHiRes();
+        const auto encodedColumns = store.encodeLowCardinalityColumns();
+        const auto encodeMilliseconds = juce::Time::getMillisecondCounterHiRes() - encodeStartTime;
+        size_t bytesSaved = 0;
+
+        for (auto& encoded : encodedColumns)
+            bytesSaved += encoded.numBytesBefore - juce::jmin (encoded.numBytesBefore, encoded.numBytesAfter);
+
+        auto* load = new juce::DynamicObject();
+        load->setProperty ("milliseconds", best);
+        load->setProperty ("encodeMilliseconds", encodeMilliseconds);
+        load->setProperty ("encodedColumns", (int) encodedColumns.size());
+        load->setProperty ("encodedBytesSaved", (juce::int64) bytesSaved);
+
+        auto* memory = new juce::DynamicObject();
+        memory->setProperty ("peakResidentBytes", getProcessMemory ("VmHWM"));
+        memory->setProperty ("residentBytes", getProcessMemory ("VmRSS"));
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("file", tableFile.getFileName());
+        result->setProperty ("fileBytes", tableFile.getSize());
+        result->setProperty ("rows", store.getNumRows());
+        result->setProperty ("columns", store.getNumColumns());
+        result->setProperty ("load", load);
+        result->setProperty ("memory", memory);
+        result->setProperty ("perColumn", benchmarkColumns (store));
+        result->setProperty ("cellAccess", benchmarkCellAccess (store));
+        return result;
+    }
+
+private:
+    /** Times making each column's sort keys, sorting by them as the sort job does, and
+        measuring the column as getColumnAutoSizeWidth() does before the cache has it.
+    */
+    static juce::var benchmarkColumns (const TableRowStore& store)
+    {
+        auto makeKeys = [&store] (int slot)
+        {
+            return store.hasSortKeys (slot) ? std::make_unique<SortKeyColumn> (store.getSortKeys (slot))
+                                            : std::make_unique<SortKeyColumn> (store.getColumnSnapshot (slot));
+        };
+
+        const auto idSlot = store.getSchema().getSlotForName ("ID");
+        auto idKeys = idSlot >= 0 ? makeKeys (idSlot) : nullptr;
+        const juce::Font font (14.0f);
+        juce::Array<juce::var> columns;
+
+        for (int slot = 0; slot < store.getNumColumns(); ++slot)
+        {
+            auto& column = store.getSchema().getColumn (slot);
+
+            auto startTime = juce::Time::getMillisecondCounterHiRes();
+            auto keys = makeKeys (slot);
+            const auto keysMilliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+            std::vector<int> rows ((size_t) store.getNumRows());
+            std::iota (rows.begin(), rows.end(), 0);
+
+            DataSorter sorter (keys.get(), idKeys.get());
+            sorter.sort (rows);
+
+            startTime = juce::Time::getMillisecondCounterHiRes();
+            auto rowsToMeasure = ColumnWidthCache::chooseRowsToMeasure (store.getNumRows());
+            std::vector<juce::String> cells;
+            cells.reserve (rowsToMeasure.size());
+
+            for (auto row : rowsToMeasure)
+                cells.push_back (store.getCell (row, slot));
+
+            const auto measurement = ColumnWidthCache::measure (cells, rowsToMeasure, font);
+            const auto measureMilliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty ("name", column.name.toString());
+            result->setProperty ("type", TableColumnSchema::getTypeName (column.type));
+            result->setProperty ("keysMilliseconds", keysMilliseconds);
+            result->setProperty ("sortMilliseconds", sorter.getLastTiming().milliseconds);
+            result->setProperty ("sortThreads", sorter.getLastTiming().numThreads);
+            result->setProperty ("autoSizeMilliseconds", measureMilliseconds);
+            result->setProperty ("rowsMeasured", (int) rowsToMeasure.size());
+            result->setProperty ("widest", measurement.widest);
+            columns.add (result);
+        }
+
+        return columns;
+    }
+
+    /** Times reading cells through a view order, in view order and at random, in
+        nanoseconds per cell.
+    */
+    static juce::var benchmarkCellAccess (const TableRowStore& store)
+    {
+        static constexpr int maxRowsToRead = 1000000;
+
+        TableViewOrder viewOrder;
+        viewOrder.setLoadOrder (store.getNumRows());
+
+        const auto numRowsToRead = juce::jmin (store.getNumRows(), maxRowsToRead);
+        const auto numCells = (double) numRowsToRead * store.getNumColumns();
+        size_t totalLength = 0;     // used, so that the reads can't be optimised away
+        juce::String formattedText;
+
+        auto timeReads = [&] (auto&& getViewRow)
+        {
+            const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+            for (int i = 0; i < numRowsToRead; ++i)
+            {
+                auto storeRow = viewOrder.getStoreRow (getViewRow (i));
+
+                for (int slot = 0; slot < store.getNumColumns(); ++slot)
+                    totalLength += (size_t) store.getCellText (storeRow, slot, formattedText).length();
+            }
+
+            return (juce::Time::getMillisecondCounterHiRes() - startTime) * 1.0e6 / juce::jmax (1.0, numCells);
+        };
+
+        juce::Random random (1);
+        std::vector<int> randomRows ((size_t) numRowsToRead);
+
+        for (auto& row : randomRows)
+            row = random.nextInt (juce::jmax (1, store.getNumRows()));
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("cellsRead", numCells);
+        result->setProperty ("sequentialNanoseconds", timeReads ([] (int i) { return i; }));
+        result->setProperty ("randomNanoseconds", timeReads ([&randomRows] (int i) { return randomRows[(size_t) i]; }));
+        result->setProperty ("charactersRead", (juce::int64) totalLength);
+        return result;
+    }
+
+    /** Returns a field of /proc/self/status in bytes, or a void var where there's no such thing. */
+    static juce::var getProcessMemory (juce::StringRef field)
+    {
+       #if JUCE_LINUX
+        juce::StringArray lines;
+        juce::File ("/proc/self/status").readLines (lines);
+
+        for (auto& line : lines)
+            if (line.upToFirstOccurrenceOf (":", false, false) == field)
+                return line.fromFirstOccurrenceOf (":", false, false).getLargeIntValue() * 1024;     // in kB
+       #else
+        juce::ignoreUnused (field);
+       #endif
+
+        return {};
+    }
+
+    static juce::var makeError (const juce::String& error)
+    {
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("error", error);
+        return result;
+    }
+};
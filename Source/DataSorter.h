@@ -0,0 +1,211 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SortKeyColumn.h"
+#include "WorkerThreads.h"
+//==============================================================================
+/**
+    Orders store rows by the collation keys of one column, breaking ties on the ID
+    column and then on the store row, so that the order is total and reading it
+    backwards gives exactly the descending order.
+*/
+class DataSorter
+{
+public:
+    DataSorter (const SortKeyColumn* keysToSortBy, const SortKeyColumn* idKeysForTies)
+        : keysToSort (keysToSortBy),
+          idKeys (idKeysForTies)
+    {
+        jassert (keysToSort != nullptr);
+    }
+
+    int compareElements (int firstRow, int secondRow) const
+    {
+        auto result = keysToSort->compare (firstRow, secondRow);                            // [1]
+
+        if (result == 0 && idKeys != nullptr)
+            result = idKeys->compare (firstRow, secondRow);                                 // [2]
+
+        if (result == 0)
+            result = firstRow < secondRow ? -1 : (firstRow > secondRow ? 1 : 0);           // [3]
+
+        return result;
+    }
+
+    /** Controls how sort() spreads its work across threads. */
+    struct Options
+    {
+        /** Lists shorter than this are sorted on the calling thread only. */
+        int parallelThreshold = 100000;
+
+        /** The number of threads a parallel sort may use, including the calling one. */
+        int maxThreads = juce::SystemStats::getNumCpus();
+    };
+
+    /** How long the last call to sort() took, for tuning Options::parallelThreshold. */
+    struct Timing
+    {
+        double milliseconds = 0.0;
+        int numRows = 0;
+        int numThreads = 0;
+    };
+
+    void setOptions (Options newOptions)            { options = newOptions; }
+    const Timing& getLastTiming() const noexcept    { return lastTiming; }
+
+    /** Sorts a list of store rows into ascending order.
+
+        Lists below the parallel threshold are sorted in runs on the calling thread and
+        the runs merged pairwise. Longer lists are cut into one slice per thread, the
+        slices sorted concurrently, and then merged in rounds where every merge is
+        split between all the threads. The comparison is the same either way, so the
+        result doesn't depend on the path taken.
+
+        shouldExit is polled between steps (from any of the threads), so a sort that is
+        no longer wanted can be abandoned quickly. Returns false if it was abandoned,
+        leaving the rows partially sorted.
+    */
+    bool sort (std::vector<int>& rows, const std::function<bool()>& shouldExit = {})
+    {
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+        const auto numThreads = (int) rows.size() < options.parallelThreshold ? 1 : juce::jmax (1, options.maxThreads);
+
+        auto completed = numThreads > 1 ? sortParallel (rows, numThreads, shouldExit)
+                                        : sortRuns (rows.begin(), rows.end(), shouldExit);
+
+        lastTiming = { juce::Time::getMillisecondCounterHiRes() - startTime, (int) rows.size(), numThreads };
+        return completed;
+    }
+
+private:
+    using RowIterator = std::vector<int>::iterator;
+
+    static constexpr size_t runLength = 1 << 16;
+
+    const SortKeyColumn* keysToSort;
+    const SortKeyColumn* idKeys;
+    Options options;
+    Timing lastTiming;
+
+    bool isLess (int first, int second) const      { return compareElements (first, second) < 0; }
+
+    static bool wasAbandoned (const std::function<bool()>& shouldExit)
+    {
+        return shouldExit != nullptr && shouldExit();
+    }
+
+    bool sortRuns (RowIterator begin, RowIterator end, const std::function<bool()>& shouldExit) const
+    {
+        auto lessThan = [this] (int first, int second) { return isLess (first, second); };
+        const auto numRows = (size_t) (end - begin);
+        auto at = [begin] (size_t index) { return begin + (std::ptrdiff_t) index; };
+
+        for (size_t start = 0; start < numRows; start += runLength)
+        {
+            if (wasAbandoned (shouldExit))
+                return false;
+
+            std::sort (at (start), at (juce::jmin (start + runLength, numRows)), lessThan);
+        }
+
+        for (size_t width = runLength; width < numRows; width *= 2)
+        {
+            for (size_t start = 0; start + width < numRows; start += 2 * width)
+            {
+                if (wasAbandoned (shouldExit))
+                    return false;
+
+                std::inplace_merge (at (start), at (start + width), at (juce::jmin (start + 2 * width, numRows)), lessThan);
+            }
+        }
+
+        return true;
+    }
+
+    bool sortParallel (std::vector<int>& rows, int numThreads, const std::function<bool()>& shouldExit) const
+    {
+        juce::SharedResourcePointer<WorkerThreads> workers;
+        std::atomic<bool> abandoned { false };
+
+        // 1. sort one slice per thread
+        std::vector<size_t> bounds;
+
+        for (int i = 0; i <= numThreads; ++i)
+            bounds.push_back (rows.size() * (size_t) i / (size_t) numThreads);
+
+        workers->runTasks (numThreads, [&] (int i)
+        {
+            if (! sortRuns (rows.begin() + (std::ptrdiff_t) bounds[(size_t) i],
+                            rows.begin() + (std::ptrdiff_t) bounds[(size_t) i + 1], shouldExit))
+                abandoned = true;
+        });
+
+        // 2. merge neighbouring slices until there's only one, ping-ponging between two buffers
+        std::vector<int> buffer (rows.size());
+        auto* source = &rows;
+        auto* dest = &buffer;
+
+        while (bounds.size() > 2 && ! abandoned)
+        {
+            std::vector<size_t> mergedBounds;
+
+            for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+            {
+                mergedBounds.push_back (bounds[i]);
+
+                if (i + 2 < bounds.size())
+                    mergeInParallel (*workers, numThreads, *source, bounds[i], bounds[i + 1], bounds[i + 2], *dest);
+                else
+                    std::copy (source->begin() + (std::ptrdiff_t) bounds[i], source->end(),
+                               dest->begin() + (std::ptrdiff_t) bounds[i]);
+            }
+
+            mergedBounds.push_back (rows.size());
+            bounds = std::move (mergedBounds);
+            std::swap (source, dest);
+
+            if (wasAbandoned (shouldExit))
+                abandoned = true;
+        }
+
+        if (source != &rows)
+            rows.swap (buffer);
+
+        return ! abandoned;
+    }
+
+    /** Merges the sorted ranges [start, middle) and [middle, end) of source into the
+        same positions of dest. The first range is cut into one piece per thread; each
+        piece finds where its first element belongs in the second range by binary
+        search, which tells it exactly which part of the output it owns. This relies
+        on compareElements() never returning 0 for two different rows.
+    */
+    void mergeInParallel (WorkerThreads& workers, int numThreads, const std::vector<int>& source,
+                          size_t start, size_t middle, size_t end, std::vector<int>& dest) const
+    {
+        auto lessThan = [this] (int first, int second) { return isLess (first, second); };
+        auto at = [&source] (size_t index) { return source.begin() + (std::ptrdiff_t) index; };
+
+        std::vector<size_t> firstSplits, secondSplits;
+
+        for (int i = 0; i <= numThreads; ++i)
+        {
+            auto firstSplit = start + (middle - start) * (size_t) i / (size_t) numThreads;
+            auto secondSplit = i == numThreads ? end
+                             : (i == 0 || firstSplit == middle) ? middle
+                             : (size_t) (std::lower_bound (at (middle), at (end), source[firstSplit], lessThan) - source.begin());
+
+            firstSplits.push_back (firstSplit);
+            secondSplits.push_back (secondSplit);
+        }
+
+        workers.runTasks (numThreads, [&] (int i)
+        {
+            auto piece = (size_t) i;
+            auto destStart = firstSplits[piece] + (secondSplits[piece] - middle);
+
+            std::merge (at (firstSplits[piece]), at (firstSplits[piece + 1]),
+                        at (secondSplits[piece]), at (secondSplits[piece + 1]),
+                        dest.begin() + (std::ptrdiff_t) destStart, lessThan);
+        });
+    }
+};
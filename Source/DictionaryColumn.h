@@ -0,0 +1,208 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SortKeyColumn.h"
+//==============================================================================
+/**
+    A text column that only has a few different values, stored as one copy of each
+    value plus a small integer code per row.
+
+    Codes are 16 bits wide until a column has more than 65536 values, which only edits
+    can cause, as encode() refuses columns with that many. Each value also gets a rank,
+    its position when the values are sorted in the same natural order SortKeyColumn
+    uses, so that a column can be sorted by comparing the ranks of its rows. Values
+    that compare equal share a rank.
+
+    Sort keys are odd numbers made from the ranks, which leaves an even key between
+    every pair of values for getSortKeyFor() to give text that isn't in the column.
+*/
+class DictionaryColumn
+{
+public:
+    /** Encodes the cells of a column, as returned by getCell (row). Returns nothing if
+        the column has more than maxNumValues different values.
+    */
+    template <typename CellFunction>
+    static std::optional<DictionaryColumn> encode (int numRows, CellFunction&& getCell, int maxNumValues)
+    {
+        jassert (maxNumValues <= 0x10000);
+
+        DictionaryColumn column;
+        column.narrowCodes.reserve ((size_t) numRows);
+
+        for (int row = 0; row < numRows; ++row)
+        {
+            const juce::String& text = getCell (row);
+            auto [entry, isNew] = column.codesByValue.emplace (text, (juce::uint32) column.values.size());
+
+            if (isNew)
+            {
+                if ((int) column.values.size() >= maxNumValues)
+                    return {};
+
+                column.values.push_back (text);
+            }
+
+            column.narrowCodes.push_back ((juce::uint16) entry->second);
+        }
+
+        column.updateRanks();
+        return column;
+    }
+
+    int getNumRows() const noexcept         { return (int) (wideCodes.empty() ? narrowCodes.size() : wideCodes.size()); }
+    int getNumValues() const noexcept       { return (int) values.size(); }
+
+    const juce::String& getText (int row) const noexcept
+    {
+        return values[getCode (row)];
+    }
+
+    /** Returns the sort key of a row's value, which sorts rows in natural order. */
+    juce::uint64 getSortKey (int row) const noexcept
+    {
+        return getSortKeyForRank (ranks[getCode (row)]);
+    }
+
+    /** Returns the sort key some text has, or would have if it were in the column, so
+        that rows can be compared with it.
+    */
+    juce::uint64 getSortKeyFor (const juce::String& text) const
+    {
+        std::vector<char> key, valueKey;
+        SortKeyColumn::encode (text, key);
+
+        auto firstNotBefore = std::partition_point (sortedCodes.begin(), sortedCodes.end(), [&] (juce::uint32 code)
+        {
+            valueKey.clear();
+            SortKeyColumn::encode (values[code], valueKey);
+            return SortKeyColumn::compareEncoded (valueKey, key) < 0;
+        });
+
+        if (firstNotBefore == sortedCodes.end())
+            return sortedCodes.empty() ? 0 : getSortKeyForRank (ranks[sortedCodes.back()]) + 1;
+
+        valueKey.clear();
+        SortKeyColumn::encode (values[*firstNotBefore], valueKey);
+
+        const auto rankKey = getSortKeyForRank (ranks[*firstNotBefore]);
+        return SortKeyColumn::compareEncoded (valueKey, key) == 0 ? rankKey : rankKey - 1;
+    }
+
+    void append (const juce::String& text)
+    {
+        auto code = getCodeFor (text);
+
+        if (wideCodes.empty())
+            narrowCodes.push_back ((juce::uint16) code);
+        else
+            wideCodes.push_back (code);
+    }
+
+    /** Changes the value of a row. Returns true if that added a value to the dictionary,
+        which changes the sort keys of other rows too.
+    */
+    bool set (int row, const juce::String& text)
+    {
+        const auto numValues = values.size();
+        auto code = getCodeFor (text);
+
+        if (wideCodes.empty())
+            narrowCodes[(size_t) row] = (juce::uint16) code;
+        else
+            wideCodes[(size_t) row] = code;
+
+        return values.size() != numValues;
+    }
+
+    /** Returns roughly how much memory the column takes up. */
+    size_t getNumBytesUsed() const noexcept
+    {
+        auto numBytes = narrowCodes.capacity() * sizeof (juce::uint16) + wideCodes.capacity() * sizeof (juce::uint32)
+                      + (ranks.capacity() + sortedCodes.capacity()) * sizeof (juce::uint32);
+
+        // each value is held by the list and by the lookup table, which share its text
+        for (auto& value : values)
+            numBytes += getNumBytesUsed (value) + sizeof (juce::String) + sizeof (juce::uint32) + 2 * sizeof (void*);
+
+        return numBytes;
+    }
+
+    /** Estimates the memory a juce::String takes up, counting its text as unshared. */
+    static size_t getNumBytesUsed (const juce::String& text) noexcept
+    {
+        return sizeof (juce::String) + (text.isEmpty() ? 0 : sizeof (int) + sizeof (size_t) + text.getNumBytesAsUTF8() + 1);
+    }
+
+private:
+    std::vector<juce::String> values;
+    std::unordered_map<juce::String, juce::uint32> codesByValue;
+    std::vector<juce::uint32> ranks;    // by code
+    std::vector<juce::uint32> sortedCodes;
+    std::vector<juce::uint16> narrowCodes;
+    std::vector<juce::uint32> wideCodes;
+
+    DictionaryColumn() = default;
+
+    juce::uint32 getCode (int row) const noexcept
+    {
+        return wideCodes.empty() ? narrowCodes[(size_t) row] : wideCodes[(size_t) row];
+    }
+
+    /** Returns the code of a value, adding it to the dictionary if it's new. */
+    juce::uint32 getCodeFor (const juce::String& text)
+    {
+        auto [entry, isNew] = codesByValue.emplace (text, (juce::uint32) values.size());
+
+        if (isNew)
+        {
+            values.push_back (text);
+
+            if (values.size() > 0x10000 && wideCodes.empty())
+            {
+                wideCodes.assign (narrowCodes.begin(), narrowCodes.end());
+                narrowCodes = {};
+            }
+
+            updateRanks();
+        }
+
+        return entry->second;
+    }
+
+    static juce::uint64 getSortKeyForRank (juce::uint32 rank) noexcept
+    {
+        return (juce::uint64) rank * 2 + 1;
+    }
+
+    void updateRanks()
+    {
+        std::vector<std::vector<char>> keys (values.size());
+        std::vector<juce::uint32> order (values.size());
+
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            SortKeyColumn::encode (values[i], keys[i]);
+            order[i] = (juce::uint32) i;
+        }
+
+        std::sort (order.begin(), order.end(), [&keys] (juce::uint32 a, juce::uint32 b)
+        {
+            return SortKeyColumn::compareEncoded (keys[a], keys[b]) < 0;
+        });
+
+        ranks.resize (values.size());
+        juce::uint32 rank = 0;
+
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            if (i > 0 && SortKeyColumn::compareEncoded (keys[order[i]], keys[order[i - 1]]) != 0)
+                ++rank;
+
+            ranks[order[i]] = rank;
+        }
+
+        sortedCodes = std::move (order);
+    }
+
+    JUCE_LEAK_DETECTOR (DictionaryColumn)
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    A bounded cache of laid-out lines of text, so that repainting a cell whose text,
+    font and size haven't changed doesn't have to lay out its glyphs and work out
+    where to put the ellipsis all over again.
+
+    A layout is the same as the one juce::Graphics::drawText() would make for the
+    same text, area and justification. Layouts are keyed by all of those, so an
+    edited cell simply misses; the least recently used layouts are dropped once the
+    cache is full.
+*/
+class GlyphLayoutCache
+{
+public:
+    explicit GlyphLayoutCache (size_t maxLayoutsToKeep = 4096)
+        : maxLayouts (maxLayoutsToKeep)
+    {}
+
+    /** Returns the layout of a line of text, truncated with an ellipsis if it doesn't fit,
+        laying it out first if it isn't already cached. The reference stays valid until
+        the next call.
+    */
+    const juce::GlyphArrangement& getLayout (juce::StringRef text, const juce::Font& font,
+                                             juce::Rectangle<int> area, juce::Justification justification)
+    {
+        const auto hash = getHash (text, font, area, justification);
+        auto range = index.equal_range (hash);
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            auto entry = it->second;
+
+            if (entry->area == area && entry->justification == justification
+                 && entry->font == font && entry->text == text)
+            {
+                layouts.splice (layouts.begin(), layouts, entry);
+                return entry->glyphs;
+            }
+        }
+
+        if (layouts.size() >= maxLayouts)
+            removeLayout (std::prev (layouts.end()));
+
+        layouts.push_front ({ hash, text, font, area, justification, {} });
+        auto& entry = layouts.front();
+
+        entry.glyphs.addCurtailedLineOfText (font, entry.text, 0.0f, 0.0f, (float) area.getWidth(), true);
+        entry.glyphs.justifyGlyphs (0, entry.glyphs.getNumGlyphs(),
+                                    (float) area.getX(), (float) area.getY(), (float) area.getWidth(), (float) area.getHeight(),
+                                    justification);
+
+        index.emplace (hash, layouts.begin());
+        return entry.glyphs;
+    }
+
+    /** Drops the layouts of any width that isn't in the list, e.g. after columns have been
+        resized, so that the old sizes don't linger until they're pushed out.
+    */
+    void removeWidthsOtherThan (const std::vector<int>& widthsToKeep)
+    {
+        for (auto it = layouts.begin(); it != layouts.end();)
+        {
+            auto next = std::next (it);
+
+            if (std::find (widthsToKeep.begin(), widthsToKeep.end(), it->area.getWidth()) == widthsToKeep.end())
+                removeLayout (it);
+
+            it = next;
+        }
+    }
+
+    void clear()
+    {
+        layouts.clear();
+        index.clear();
+    }
+
+    size_t size() const noexcept        { return layouts.size(); }
+
+private:
+    struct Layout
+    {
+        juce::uint64 hash;
+        juce::String text;
+        juce::Font font;
+        juce::Rectangle<int> area;
+        juce::Justification justification;
+        juce::GlyphArrangement glyphs;
+    };
+
+    using LayoutList = std::list<Layout>;
+
+    const size_t maxLayouts;
+    LayoutList layouts;     // most recently used first
+    std::unordered_multimap<juce::uint64, LayoutList::iterator> index;
+
+    void removeLayout (LayoutList::iterator layout)
+    {
+        auto range = index.equal_range (layout->hash);
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == layout)
+            {
+                index.erase (it);
+                break;
+            }
+        }
+
+        layouts.erase (layout);
+    }
+
+    static juce::uint64 getHash (juce::StringRef text, const juce::Font& font,
+                                 juce::Rectangle<int> area, juce::Justification justification) noexcept
+    {
+        juce::uint64 hash = 14695981039346656037ull;    // FNV-1a
+        auto add = [&hash] (juce::uint64 value) { hash = (hash ^ value) * 1099511628211ull; };
+
+        for (auto* c = text.text.getAddress(); *c != 0; ++c)
+            add ((juce::uint8) *c);
+
+        add ((juce::uint64) area.getX());
+        add ((juce::uint64) area.getY());
+        add ((juce::uint64) area.getWidth());
+        add ((juce::uint64) area.getHeight());
+        add ((juce::uint64) justification.getFlags());
+        add ((juce::uint64) juce::roundToInt (font.getHeight() * 100.0f));
+        add ((juce::uint64) font.getStyleFlags());
+
+        return hash;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GlyphLayoutCache)
+};
@@ -0,0 +1,432 @@
+#pragma once
+#include <JuceHeader.h>
+
+/** Set this to 1 to build the profiler's timers and counters into the hot paths of the
+    table. With it at 0, TABLE_PROFILE_SCOPE and TABLE_PROFILE_COUNT are empty and cost
+    nothing at all.
+*/
+#ifndef TABLE_PROFILING
+ #define TABLE_PROFILING 0
+#endif
+
+//==============================================================================
+/**
+    Times and counts the hot paths of the table, such as loading, sorting and
+    painting, so that a slow table can be blamed on the right one.
+
+    Each thread that reaches a probe gets a buffer of its own, where it adds up each
+    probe's calls, total and longest time without any locks, and where it records a
+    trace event per call while a trace is being recorded. Readers only look at the
+    buffers: getTotals() sums them for the overlay, and writeChromeTrace() writes the
+    events out as Chrome trace-event JSON, which chrome://tracing and Perfetto open.
+
+    The event buffers are rings, so a long trace keeps its most recent events. A
+    thread that's still writing may overwrite the oldest events while a trace is
+    written, so the oldest quarter of a full ring is left out.
+*/
+class HotPathProfiler
+{
+public:
+    static constexpr int maxProbes = 64;
+    static constexpr int eventsPerThread = 1 << 16;
+
+    /** A timer or counter in the code. Each one is a function-local static, which
+        registers itself when it's first reached.
+    */
+    struct Probe
+    {
+        Probe (const char* probeName, bool isCounterProbe)
+            : id (getInstance().registerProbe (probeName, isCounterProbe))
+        {}
+
+        const int id;
+    };
+
+    /** Times the scope it lives in, if the profiler is enabled when it's created. */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer (const Probe& probeToTime) noexcept
+            : probe (probeToTime),
+              startTicks (getInstance().isEnabled() ? juce::Time::getHighResolutionTicks() : 0)
+        {}
+
+        ~ScopedTimer()
+        {
+            if (startTicks != 0)
+                getInstance().addTime (probe, startTicks, juce::Time::getHighResolutionTicks());
+        }
+
+    private:
+        const Probe& probe;
+        const juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedTimer)
+    };
+
+    static HotPathProfiler& getInstance()
+    {
+        static HotPathProfiler profiler;
+        return profiler;
+    }
+
+    //==============================================================================
+    void setEnabled (bool shouldBeEnabled) noexcept     { enabled.store (shouldBeEnabled, std::memory_order_relaxed); }
+    bool isEnabled() const noexcept                     { return enabled.load (std::memory_order_relaxed); }
+
+    /** Starts or stops recording an event for every call, as well as adding it up. */
+    void setRecordingTrace (bool shouldRecord) noexcept { recordingTrace.store (shouldRecord, std::memory_order_relaxed); }
+    bool isRecordingTrace() const noexcept              { return recordingTrace.load (std::memory_order_relaxed); }
+
+    void addTime (const Probe& probe, juce::int64 startTicks, juce::int64 endTicks) noexcept
+    {
+        add (probe, startTicks, endTicks - startTicks);
+    }
+
+    void addCount (const Probe& probe, juce::int64 amount) noexcept
+    {
+        if (isEnabled())
+            add (probe, juce::Time::getHighResolutionTicks(), amount);
+    }
+
+    //==============================================================================
+    /** A probe's calls on every thread so far. For a counter, total is the sum of the
+        amounts it was given, and longest the biggest of them.
+    */
+    struct Totals
+    {
+        juce::String name;
+        bool isCounter = false;
+        juce::uint64 numCalls = 0;
+        juce::uint64 total = 0;
+        juce::uint64 longest = 0;
+    };
+
+    /** Returns the totals of each probe, in the order they were first reached. Times are
+        in high-resolution ticks.
+    */
+    std::vector<Totals> getTotals() const
+    {
+        const juce::ScopedLock sl (lock);
+        std::vector<Totals> totals (probes.size());
+
+        for (size_t id = 0; id < probes.size(); ++id)
+            totals[id] = { probes[id].name, probes[id].isCounter, 0, 0, 0 };
+
+        for (auto& buffer : buffers)
+        {
+            for (size_t id = 0; id < probes.size(); ++id)
+            {
+                auto& stats = buffer->stats[id];
+                totals[id].numCalls += stats.numCalls.load (std::memory_order_relaxed);
+                totals[id].total    += stats.total.load (std::memory_order_relaxed);
+                totals[id].longest   = juce::jmax (totals[id].longest, stats.longest.load (std::memory_order_relaxed));
+            }
+        }
+
+        return totals;
+    }
+
+    /** Writes the recorded events as Chrome trace-event JSON: timers as complete events
+        and counters as counter events, on one track per thread.
+    */
+    bool writeChromeTrace (const juce::File& traceFile) const
+    {
+        traceFile.deleteFile();
+        juce::FileOutputStream output (traceFile, 1 << 20);
+
+        if (! output.openedOk())
+            return false;
+
+        const juce::ScopedLock sl (lock);
+        const auto microsecondsPerTick = 1.0e6 / (double) juce::Time::getHighResolutionTicksPerSecond();
+        auto firstTicks = std::numeric_limits<juce::int64>::max();
+
+        auto forEachEvent = [this] (auto&& callback)
+        {
+            for (auto& buffer : buffers)
+            {
+                const auto numWritten = buffer->numEventsWritten.load (std::memory_order_acquire);
+                const auto numToSkip = numWritten > (juce::uint64) eventsPerThread ? (juce::uint64) eventsPerThread / 4 : 0;
+                const auto first = numWritten - juce::jmin (numWritten, (juce::uint64) eventsPerThread) + numToSkip;
+
+                for (auto i = first; i < numWritten; ++i)
+                    callback (*buffer, buffer->events[(size_t) (i % eventsPerThread)]);
+            }
+        };
+
+        forEachEvent ([&firstTicks] (const ThreadBuffer&, const Event& event) { firstTicks = juce::jmin (firstTicks, event.startTicks); });
+
+        output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        auto separator = "\n";
+
+        for (auto& buffer : buffers)
+        {
+            output << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex
+                   << ",\"args\":{\"name\":" << juce::JSON::toString (buffer->threadName) << "}}";
+            separator = ",\n";
+        }
+
+        forEachEvent ([&] (const ThreadBuffer& buffer, const Event& event)
+        {
+            auto& probe = probes[(size_t) event.probeId];
+            const auto timestamp = (double) (event.startTicks - firstTicks) * microsecondsPerTick;
+
+            output << separator << "{\"name\":" << juce::JSON::toString (probe.name)
+                   << ",\"cat\":\"table\",\"pid\":1,\"tid\":" << buffer.threadIndex
+                   << ",\"ts\":" << juce::String (timestamp, 3);
+
+            if (probe.isCounter)
+                output << ",\"ph\":\"C\",\"args\":{\"value\":" << juce::String (event.value) << "}}";
+            else
+                output << ",\"ph\":\"X\",\"dur\":" << juce::String ((double) event.value * microsecondsPerTick, 3) << "}";
+
+            separator = ",\n";
+        });
+
+        output << "\n]}\n";
+        output.flush();
+        return output.getStatus().wasOk();
+    }
+
+private:
+    struct ProbeInfo
+    {
+        juce::String name;
+        bool isCounter = false;
+    };
+
+    struct Event
+    {
+        int probeId;
+        juce::int64 startTicks;
+        juce::int64 value;      // a timer's duration in ticks, or a counter's amount
+    };
+
+    struct Stats
+    {
+        std::atomic<juce::uint64> numCalls { 0 }, total { 0 }, longest { 0 };
+    };
+
+    /** Written by its own thread only, so the atomics are only there to let other
+        threads read them while it does.
+    */
+    struct ThreadBuffer
+    {
+        int threadIndex = 0;
+        juce::String threadName;
+        std::array<Stats, maxProbes> stats;
+        std::unique_ptr<Event[]> events;
+        std::atomic<juce::uint64> numEventsWritten { 0 };
+        std::atomic<bool> isInUse { true };
+    };
+
+    /** Lets a thread's buffer be taken over by a new thread once the thread has ended. */
+    struct ThreadBufferHandle
+    {
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadBufferHandle()
+        {
+            if (buffer != nullptr)
+                buffer->isInUse.store (false, std::memory_order_release);
+        }
+    };
+
+    std::atomic<bool> enabled { true }, recordingTrace { false };
+    juce::CriticalSection lock;     // only taken to add probes or threads, and by readers
+    std::vector<ProbeInfo> probes;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    HotPathProfiler() = default;
+
+    int registerProbe (const char* name, bool isCounter)
+    {
+        const juce::ScopedLock sl (lock);
+
+        if ((int) probes.size() >= maxProbes)
+        {
+            jassertfalse;   // raise maxProbes
+            return -1;
+        }
+
+        probes.push_back ({ name, isCounter });
+        return (int) probes.size() - 1;
+    }
+
+    void add (const Probe& probe, juce::int64 startTicks, juce::int64 value) noexcept
+    {
+        if (probe.id < 0)
+            return;
+
+        auto& buffer = getThreadBuffer();
+        auto& stats = buffer.stats[(size_t) probe.id];
+        const auto amount = (juce::uint64) juce::jmax ((juce::int64) 0, value);
+
+        stats.numCalls.store (stats.numCalls.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        stats.total.store (stats.total.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+
+        if (amount > stats.longest.load (std::memory_order_relaxed))
+            stats.longest.store (amount, std::memory_order_relaxed);
+
+        if (isRecordingTrace())
+        {
+            if (buffer.events == nullptr)
+                buffer.events.reset (new Event[(size_t) eventsPerThread]);     // only threads that get traced pay for it
+
+            const auto index = buffer.numEventsWritten.load (std::memory_order_relaxed);
+            buffer.events[(size_t) (index % eventsPerThread)] = { probe.id, startTicks, value };
+            buffer.numEventsWritten.store (index + 1, std::memory_order_release);
+        }
+    }
+
+    ThreadBuffer& getThreadBuffer()
+    {
+        thread_local ThreadBufferHandle handle;
+
+        if (handle.buffer == nullptr)
+            handle.buffer = takeThreadBuffer();
+
+        return *handle.buffer;
+    }
+
+    ThreadBuffer* takeThreadBuffer()
+    {
+        auto threadName = juce::MessageManager::existsAndIsCurrentThread() ? juce::String ("Message thread") : juce::String ("Worker");
+
+        if (auto* thread = juce::Thread::getCurrentThread())
+            threadName = thread->getThreadName();
+
+        const juce::ScopedLock sl (lock);
+
+        // a buffer left by a thread that has ended keeps its totals, which still count
+        for (auto& buffer : buffers)
+        {
+            auto wasInUse = false;
+
+            if (buffer->isInUse.compare_exchange_strong (wasInUse, true))
+            {
+                buffer->threadName = threadName;
+                return buffer.get();
+            }
+        }
+
+        buffers.push_back (std::make_unique<ThreadBuffer>());
+        buffers.back()->threadIndex = (int) buffers.size();
+        buffers.back()->threadName = threadName;
+        return buffers.back().get();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (HotPathProfiler)
+};
+
+#if TABLE_PROFILING
+ #define TABLE_PROFILE_SCOPE(name) \
+    static const HotPathProfiler::Probe JUCE_JOIN_MACRO (tableProfileProbe, __LINE__) (name, false); \
+    const HotPathProfiler::ScopedTimer JUCE_JOIN_MACRO (tableProfileTimer, __LINE__) (JUCE_JOIN_MACRO (tableProfileProbe, __LINE__))
+
+ #define TABLE_PROFILE_COUNT(name, amount) \
+    do { static const HotPathProfiler::Probe tableProfileProbe (name, true); \
+         HotPathProfiler::getInstance().addCount (tableProfileProbe, (juce::int64) (amount)); } while (false)
+#else
+ #define TABLE_PROFILE_SCOPE(name)
+ #define TABLE_PROFILE_COUNT(name, amount)
+#endif
+
+//==============================================================================
+/**
+    Shows the profiler's totals over the table twice a second: how often each probe
+    was reached in the last half second, how long it took on average and at most, and
+    how much of each second it took up.
+*/
+class HotPathOverlay  : public juce::Component,
+                        private juce::Timer
+{
+public:
+    HotPathOverlay()
+    {
+        setInterceptsMouseClicks (false, false);
+    }
+
+    void visibilityChanged() override
+    {
+        if (isVisible())
+            startTimer (500);
+        else
+            stopTimer();
+    }
+
+    /** Shows a line under the probes, such as where a trace went, until it's replaced. */
+    void setStatus (const juce::String& newStatus)
+    {
+        status = newStatus;
+        updateHeight();
+        repaint();
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        g.fillAll (juce::Colours::black.withAlpha (0.7f));
+        g.setColour (juce::Colours::white);
+        g.setFont (juce::Font (juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+
+        auto area = getLocalBounds().reduced (6, 4);
+        g.drawText (juce::String ("probe").paddedRight (' ', 24) + "  calls/s    mean us     max us   ms/s",
+                    area.removeFromTop (lineHeight), juce::Justification::centredLeft, false);
+
+        for (auto& line : lines)
+            g.drawText (line, area.removeFromTop (lineHeight), juce::Justification::centredLeft, false);
+
+        if (status.isNotEmpty())
+            g.drawText (status, area.removeFromTop (lineHeight), juce::Justification::centredLeft, true);
+    }
+
+private:
+    static constexpr int lineHeight = 15;
+
+    std::vector<HotPathProfiler::Totals> lastTotals;
+    double lastTime = 0.0;
+    juce::StringArray lines;
+    juce::String status;
+
+    void updateHeight()
+    {
+        setSize (getWidth(), (lines.size() + (status.isNotEmpty() ? 2 : 1)) * lineHeight + 8);
+    }
+
+    void timerCallback() override
+    {
+        auto totals = HotPathProfiler::getInstance().getTotals();
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        const auto seconds = lastTime > 0.0 ? (now - lastTime) / 1000.0 : 0.0;
+        const auto millisecondsPerTick = 1000.0 / (double) juce::Time::getHighResolutionTicksPerSecond();
+
+        lines.clear();
+
+        for (size_t i = 0; i < totals.size() && seconds > 0.0; ++i)
+        {
+            auto& probe = totals[i];
+            const auto before = i < lastTotals.size() ? lastTotals[i] : HotPathProfiler::Totals();
+            const auto numCalls = probe.numCalls - before.numCalls;
+            const auto total = (double) (probe.total - before.total);
+
+            auto line = probe.name.paddedRight (' ', 24) + juce::String (juce::roundToInt ((double) numCalls / seconds)).paddedLeft (' ', 10);
+
+            if (probe.isCounter)
+                line << "  total " << juce::String (juce::roundToInt (total / seconds)) << "/s";
+            else
+                line << juce::String (numCalls > 0 ? total * millisecondsPerTick * 1000.0 / (double) numCalls : 0.0, 1).paddedLeft (' ', 11)
+                     << juce::String ((double) probe.longest * millisecondsPerTick * 1000.0, 1).paddedLeft (' ', 11)
+                     << juce::String (total * millisecondsPerTick / seconds, 2).paddedLeft (' ', 7);
+
+            lines.add (line);
+        }
+
+        lastTotals = std::move (totals);
+        lastTime = now;
+        updateHeight();
+        repaint();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HotPathOverlay)
+};
@@ -1,36 +1,62 @@
 #pragma once
 #include <JuceHeader.h>
+#include "TableRowStore.h"
+#include "TableViewOrder.h"
+#include "DataSorter.h"
+#include "TableDataReader.h"
+#include "ColumnWidthCache.h"
+#include "GlyphLayoutCache.h"
+#include "RowImageCache.h"
+#include "SelectionBits.h"
+#include "TrigramIndex.h"
+#include "ColumnIndex.h"
+#include "TableJournal.h"
+#include "HotPathProfiler.h"
 //==============================================================================
 class PropertyWndComponent    : public juce::Component,
-                                  public juce::TableListBoxModel
+                                  public juce::TableListBoxModel,
+                                  private juce::Timer,
+                                  private juce::AsyncUpdater,
+                                  private juce::TableHeaderComponent::Listener,
+                                  private juce::ScrollBar::Listener
 {
 public:
     PropertyWndComponent()
+        : PropertyWndComponent (juce::File::getCurrentWorkingDirectory().getChildFile ("TableData.xml"))
+    {
+    }
+
+    /** Shows a table file, which starts loading straight away. */
+    explicit PropertyWndComponent (const juce::File& tableFile)
     {
 #if 1
-        juce::String strPath = "TableData.xml";
-        juce::File f = juce::File::getCurrentWorkingDirectory().getChildFile(strPath);
-        loadData(f);                                             // [1]
+        tlbObject.setHeader (std::make_unique<SelectionHeader> (*this));              // before any columns are added
+
+        loadData(tableFile);                                     // [1]
 
         addAndMakeVisible(tlbObject);                                                  // [1]
 
         tlbObject.setColour(juce::ListBox::outlineColourId, juce::Colours::grey);      // [2]
-        tlbObject.setOutlineThickness(1);
-        if (columnList != nullptr)
-        {
-            for (auto* columnXml : columnList->getChildIterator())
-            {
-                tlbObject.getHeader().addColumn(columnXml->getStringAttribute("name"), // [2]
-                    columnXml->getIntAttribute("columnId"),
-                    columnXml->getIntAttribute("width"),
-                    50,
-                    400,
-                    juce::TableHeaderComponent::defaultFlags);
-            }
-        }
-        tlbObject.getHeader().setSortColumnId(1, true);                                // [3]
+        tlbObject.setOutlineThickness(1);                                              // the columns are added by schemaLoaded()
 
         tlbObject.setMultipleSelectionEnabled(true);                                   // [4]
+        tlbObject.getHeader().addListener(this);
+        tlbObject.getVerticalScrollBar().addListener(this);
+        tlbObject.getHorizontalScrollBar().addListener(this);
+        tlbObject.addAndMakeVisible (selectionBoxClickCatcher);                        // over the rows, so it sees clicks first
+
+        addAndMakeVisible(filterBox);
+        filterBox.setTextToShowWhenEmpty ("Filter", juce::Colours::grey);
+        filterBox.onTextChange = [this] { setFilterText (filterBox.getText()); };
+
+        addChildComponent(cellEditor);
+        cellEditor.onReturnKey = [this] { finishEditing (true);  tlbObject.grabKeyboardFocus(); };
+        cellEditor.onEscapeKey = [this] { finishEditing (false); tlbObject.grabKeyboardFocus(); };
+        cellEditor.onFocusLost = [this] { finishEditing (true); };
+
+       #if TABLE_PROFILING
+        addChildComponent (profilerOverlay);
+       #endif
 
         resized();
 #else
@@ -42,19 +68,6 @@ public:
 
             table.setColour(juce::ListBox::outlineColourId, juce::Colours::grey);      // [2]
             table.setOutlineThickness(1);
-            if (columnList != nullptr)
-            {
-                for (auto* columnXml : columnList->getChildIterator())
-                {
-                    table.getHeader().addColumn(columnXml->getStringAttribute("name"), // [2]
-                        columnXml->getIntAttribute("columnId"),
-                        columnXml->getIntAttribute("width"),
-                        50,
-                        400,
-                        juce::TableHeaderComponent::defaultFlags);
-                }
-            }
-            table.getHeader().setSortColumnId(1, true);                                // [3]
 
             table.setMultipleSelectionEnabled(true);                                   // [4]
 
@@ -70,252 +83,2973 @@ public:
         
     }
     ~PropertyWndComponent() {
+        fileWatcher.reset();
+
+        if (journal != nullptr)
+            journal->close();
+
+        loadThread.reset();
+        backgroundPool.removeAllJobs(true, 4000);
+        sortPool.removeAllJobs(true, 2000);
+        tlbObject.getHeader().removeListener(this);
+        tlbObject.getVerticalScrollBar().removeListener(this);
+        tlbObject.getHorizontalScrollBar().removeListener(this);
         tlbObject.setModel(nullptr);
     }
 
     int getNumRows() override
     {
-        return numRows;
+        return viewOrder.getNumRows();
     }
 
-    void paintRowBackground (juce::Graphics& g, int rowNumber, int /*width*/, int /*height*/, bool rowIsSelected) override
+    void paintRowBackground (juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override
     {
-        auto alternateColour = getLookAndFeel().findColour (juce::ListBox::backgroundColourId)
-                                               .interpolatedWith (getLookAndFeel().findColour (juce::ListBox::textColourId), 0.03f);
-        if (rowIsSelected)
-            g.fillAll (juce::Colours::lightblue);
-        else if (rowNumber % 2)
-            g.fillAll (alternateColour);
+        TABLE_PROFILE_SCOPE ("paintRowBackground");
+        rowPaintedFromImage = -1;
+
+        if (useRowImages && paintRowFromImage (g, rowNumber, width, height, rowIsSelected))
+        {
+            rowPaintedFromImage = rowNumber;    // its cells are in the image already
+            ++paintCounts.numRowsFromImages;
+            return;
+        }
+
+        drawRowBackground (g, rowNumber, rowIsSelected);
     }
 
     void paintCell (juce::Graphics& g, int rowNumber, int columnId,
                     int width, int height, bool rowIsSelected) override
     {
-        g.setColour (rowIsSelected ? juce::Colours::darkblue : getLookAndFeel().findColour (juce::ListBox::textColourId));  // [5]
-        g.setFont (font);
+        TABLE_PROFILE_SCOPE ("paintCell");
 
-        if (auto* rowElement = dataList->getChildElement (rowNumber))
+        if (rowNumber != rowPaintedFromImage)
         {
-            auto text = rowElement->getStringAttribute (getAttributeNameForColumnId (columnId));
-
-            g.drawText (text, 2, 0, width - 4, height, juce::Justification::centredLeft, true);                             // [6]
+            drawCell (g, rowNumber, columnId, width, height, rowIsSelected);
+            ++paintCounts.numCellsDrawn;
         }
-
-        g.setColour (getLookAndFeel().findColour (juce::ListBox::backgroundColourId));
-        g.fillRect (width - 1, 0, 1, height);                                                                               // [7]
     }
 
     void sortOrderChanged (int newSortColumnId, bool isForwards) override
     {
-        if (newSortColumnId != 0)
-        {
-            DataSorter sorter (getAttributeNameForColumnId (newSortColumnId), isForwards);
-            dataList->sortChildElements (sorter);
+        TABLE_PROFILE_SCOPE ("sortOrderChanged");
 
-            tlbObject.updateContent();
-        }
-    }
+        if (loadThread != nullptr || getSlotForColumnId (newSortColumnId) < 0)
+            return;     // a table that's still loading gets sorted by loadFinished()
 
-    Component* refreshComponentForCell (int rowNumber, int columnId, bool /*isRowSelected*/,
-                                        Component* existingComponentToUpdate) override
-    {
-        if (columnId == 9)  // [8]
+        if (auto& index = columnIndexes[(size_t) getSlotForColumnId (newSortColumnId)])
         {
-            auto* selectionBox = static_cast<SelectionColumnCustomComponent*> (existingComponentToUpdate);
-
-            if (selectionBox == nullptr)
-                selectionBox = new SelectionColumnCustomComponent (*this);
-
-            selectionBox->setRowAndColumn (rowNumber, columnId);
-            return selectionBox;
+            cancelPendingSort();
+            showSortedRows (index->getSortedRows(), isForwards);     // an index is the column's sorted order already
         }
-
-        if (columnId == 8)  // [9]
+        else if (auto sortedRows = sortCache.find (newSortColumnId))
         {
-            auto* textLabel = static_cast<EditableTextCustomComponent*> (existingComponentToUpdate);
-
-            if (textLabel == nullptr)
-                textLabel = new EditableTextCustomComponent (*this);
-
-            textLabel->setRowAndColumn (rowNumber, columnId);
-            return textLabel;
+            cancelPendingSort();
+            showSortedRows (sortedRows, isForwards);
+        }
+        else
+        {
+            startSort (newSortColumnId, isForwards);
         }
+    }
+
+    void cellDoubleClicked (int rowNumber, int columnId, const juce::MouseEvent&) override
+    {
+        if (columnId == descriptionColumnId)
+            showCellEditor (rowNumber, columnId);
+    }
 
+    /** Every cell is painted, so there are no components to refresh; this is only here
+        so that the profiler can count how often the list asks.
+    */
+    juce::Component* refreshComponentForCell (int, int, bool, juce::Component* existingComponentToUpdate) override
+    {
+        TABLE_PROFILE_SCOPE ("refreshComponentForCell");
         jassert (existingComponentToUpdate == nullptr);
-        return nullptr;     // [10]
+        juce::ignoreUnused (existingComponentToUpdate);
+        return nullptr;
     }
 
     int getColumnAutoSizeWidth (int columnId) override
     {
-        if (columnId == 9)
+        TABLE_PROFILE_SCOPE ("getColumnAutoSizeWidth");
+
+        if (columnId == selectColumnId)
             return 50;
 
-        int widest = 32;
+        auto slot = getSlotForColumnId (columnId);
+        auto widest = columnWidths.getWidest (slot, font);
 
-        for (auto i = getNumRows(); --i >= 0;)
+        if (widest < 0)
         {
-            if (auto* rowElement = dataList->getChildElement (i))
-            {
-                auto text = rowElement->getStringAttribute (getAttributeNameForColumnId (columnId));
-
-                widest = juce::jmax (widest, font.getStringWidth (text));
-            }
+            // not measured yet, so measure it now rather than wait for the background job
+            auto rows = ColumnWidthCache::chooseRowsToMeasure (rowStore.getNumRows());
+            auto measurement = ColumnWidthCache::measure (getCellsToMeasure (slot, rows), rows, font);
+            columnWidths.setMeasurement (slot, columnWidths.getVersion (slot), measurement);
+            widest = measurement.widest;
         }
 
-        return widest + 8;
+        return juce::jmax (32, widest) + 8;
     }
 
     int getSelection (const int rowNumber) const
     {
-        return dataList->getChildElement (rowNumber)->getIntAttribute ("Select");
+        return selectionFlags[viewOrder.getStoreRow (rowNumber)] ? 1 : 0;
     }
 
     void setSelection (const int rowNumber, const int newSelection)
     {
-        dataList->getChildElement (rowNumber)->setAttribute ("Select", newSelection);
+        auto edit = beginEdit (newSelection != 0 ? "Tick row" : "Untick row");
+        edit.setSelection (rowNumber, newSelection != 0);
     }
 
     juce::String getText (const int columnNumber, const int rowNumber) const
     {
-        return dataList->getChildElement (rowNumber)->getStringAttribute (getAttributeNameForColumnId (columnNumber));
+        if (columnNumber == selectColumnId)
+            return juce::String (getSelection (rowNumber));
+
+        return rowStore.getCell (viewOrder.getStoreRow (rowNumber), getSlotForColumnId (columnNumber));
     }
 
-    void setText (const int columnNumber, const int rowNumber, const juce::String& newText)
+    /** Returns true if a cell has been edited since the table file was last read or written. */
+    bool isCellUnsaved (const int columnNumber, const int rowNumber) const
     {
-        const auto& columnName = tlbObject.getHeader().getColumnName (columnNumber);
-        dataList->getChildElement (rowNumber)->setAttribute (columnName, newText);
+        auto storeRow = viewOrder.getStoreRow (rowNumber);
+
+        if (columnNumber == selectColumnId)
+            return unsavedFlags[storeRow];
+
+        return unsavedCells.find ({ storeRow, columnNumber }) != unsavedCells.end();
     }
 
-    void resized() override
+    void setText (const int columnNumber, const int rowNumber, const juce::String& newText)
     {
-        tlbObject.setBoundsInset (juce::BorderSize<int> (8));
+        auto edit = beginEdit ("Edit cell");
+        edit.setText (columnNumber, rowNumber, newText);
     }
 
-private:
-    juce::TableListBox tlbObject  { {}, this };
-    juce::Font font           { 14.0f };
+    //==============================================================================
+    /** One cell's text before and after an edit. The Select column's text is "1" or "0". */
+    struct CellChange
+    {
+        int storeRow, columnId;
+        juce::String before, after;
+    };
 
-    std::unique_ptr<juce::XmlElement> tutorialData;
-    juce::XmlElement* columnList = nullptr;
-    juce::XmlElement* dataList = nullptr;
-    int numRows = 0;
+    /** Collects edits of many cells and makes them all at once. The sort keys, indexes,
+        filter and column widths are brought up to date and the rows repainted once for
+        the lot, rather than after every cell, and the whole transaction goes on the undo
+        history as one step.
 
-    class EditableTextCustomComponent  : public juce::Label
+        A transaction is committed when it's destroyed, unless cancel() is called first.
+    */
+    class EditTransaction
     {
     public:
-        EditableTextCustomComponent (PropertyWndComponent& td)
-            : owner (td)
-        {
-            setEditable (false, true, false);
-        }
+        EditTransaction (EditTransaction&&) noexcept = default;
+        EditTransaction& operator= (EditTransaction&&) = delete;
+        ~EditTransaction()                                  { commit(); }
 
-        void mouseDown (const juce::MouseEvent& event) override
+        /** Changes the text of a cell in a view row. Rows are looked up when the edit is
+            added, so the view changing before commit() doesn't move it.
+        */
+        void setText (int columnId, int rowNumber, const juce::String& newText)
         {
-            owner.tlbObject.selectRowsBasedOnModifierKeys (row, event.mods, false);
+            auto storeRow = owner->viewOrder.getStoreRow (rowNumber);
 
-            Label::mouseDown (event);
+            if (storeRow >= 0 && (columnId == selectColumnId || owner->getSlotForColumnId (columnId) >= 0))
+                changes.push_back ({ storeRow, columnId, {}, newText });
         }
 
-        void textWasEdited() override
+        void setSelection (int rowNumber, bool shouldBeSelected)
         {
-            owner.setText (columnId, row, getText());
+            setText (selectColumnId, rowNumber, shouldBeSelected ? "1" : "0");
         }
 
-        void setRowAndColumn (const int newRow, const int newColumn)
+        int getNumChanges() const noexcept                  { return (int) changes.size(); }
+
+        /** Makes the edits that have been added so far. */
+        void commit()
         {
-            row = newRow;
-            columnId = newColumn;
-            setText (owner.getText(columnId, row), juce::dontSendNotification);
+            if (! changes.empty())
+                owner->commitEdit (name, std::exchange (changes, {}));
         }
 
+        /** Forgets the edits that haven't been committed yet. */
+        void cancel() noexcept                              { changes.clear(); }
+
     private:
-        PropertyWndComponent& owner;
-        int row, columnId;
-        juce::Colour textColour;
+        friend class PropertyWndComponent;
+
+        EditTransaction (PropertyWndComponent& ownerToEdit, const juce::String& transactionName)
+            : owner (&ownerToEdit), name (transactionName)
+        {}
+
+        PropertyWndComponent* owner;
+        juce::String name;
+        std::vector<CellChange> changes;
+
+        JUCE_DECLARE_NON_COPYABLE (EditTransaction)
     };
 
-    class SelectionColumnCustomComponent    : public Component
+    /** Starts a transaction of cell edits, which gets the given name in the undo history. */
+    EditTransaction beginEdit (const juce::String& transactionName = "Edit cells")
     {
-    public:
-        SelectionColumnCustomComponent (PropertyWndComponent& td)
-            : owner (td)
+        return { *this, transactionName };
+    }
+
+    /** Returns the undo history of the edits, which is cleared when a table is loaded. */
+    juce::UndoManager& getUndoManager() noexcept                { return undoManager; }
+
+    bool undo()
+    {
+        finishEditing (true);
+        return undoManager.undo();
+    }
+
+    bool redo()
+    {
+        finishEditing (true);
+        return undoManager.redo();
+    }
+
+    bool keyPressed (const juce::KeyPress& key) override
+    {
+       #if TABLE_PROFILING
+        if (key == juce::KeyPress ('p', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0))
+        {
+            profilerOverlay.setVisible (! profilerOverlay.isVisible());
+            return true;
+        }
+
+        if (key == juce::KeyPress ('t', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0))
+        {
+            toggleTraceRecording();
+            return true;
+        }
+       #endif
+
+        if (key == juce::KeyPress ('z', juce::ModifierKeys::commandModifier, 0))
+            return undo();
+
+        if (key == juce::KeyPress ('z', juce::ModifierKeys::commandModifier | juce::ModifierKeys::shiftModifier, 0)
+             || key == juce::KeyPress ('y', juce::ModifierKeys::commandModifier, 0))
+            return redo();
+
+        return false;
+    }
+
+    void resized() override
+    {
+        finishEditing (true);
+
+        auto area = getLocalBounds().reduced (8);
+        filterBox.setBounds (area.removeFromTop (24));
+        tlbObject.setBounds (area.withTrimmedTop (4));
+        selectionBoxClickCatcher.setBounds (tlbObject.getLocalBounds());
+
+       #if TABLE_PROFILING
+        profilerOverlay.setBounds (tlbObject.getBounds().removeFromRight (480).withHeight (profilerOverlay.getHeight()));
+       #endif
+    }
+
+   #if TABLE_PROFILING
+    /** Starts recording a trace of the hot paths, or stops and writes it beside the
+        table file as Chrome trace-event JSON. The overlay shows what happened.
+    */
+    void toggleTraceRecording()
+    {
+        auto& profiler = HotPathProfiler::getInstance();
+        profilerOverlay.setVisible (true);
+
+        if (! profiler.isRecordingTrace())
         {
-            addAndMakeVisible (toggleButton);
+            if (loadedFile == juce::File())
+            {
+                profilerOverlay.setStatus ("No table is loaded, so there's nowhere to write a trace");
+                return;
+            }
+
+            profiler.setRecordingTrace (true);
+            profilerOverlay.setStatus ("Recording a trace");
+            return;
+        }
 
-            toggleButton.onClick = [this] { owner.setSelection (row, (int) toggleButton.getToggleState()); };
+        profiler.setRecordingTrace (false);
+
+        if (loadedFile == juce::File())
+        {
+            profilerOverlay.setStatus ("No table is loaded, so the trace wasn't written");
+            return;
         }
 
-        void resized() override
+        auto traceFile = loadedFile.getSiblingFile (loadedFile.getFileNameWithoutExtension() + ".trace.json");
+
+        profilerOverlay.setStatus (profiler.writeChromeTrace (traceFile) ? "Wrote a trace to " + traceFile.getFullPathName()
+                                                                         : "Couldn't write a trace to " + traceFile.getFullPathName());
+    }
+   #endif
+
+    /** Narrows the view down to the rows that have a text cell containing some text,
+        ignoring the case of ASCII letters. Text that extends the previous filter text
+        only has to check the rows that matched that.
+    */
+    void setFilterText (const juce::String& newText)
+    {
+        auto query = TrigramIndex::fold (newText);
+
+        if (query == filterQuery)
+            return;
+
+        if (query.empty())
         {
-            toggleButton.setBoundsInset (juce::BorderSize<int> (2));
+            filterQuery.clear();
+            showFilteredRows (nullptr);
+            return;
         }
 
-        void setRowAndColumn (int newRow, int newColumn)
+        std::vector<int> candidates;
+
+        if (filteredRows != nullptr && query.find (filterQuery) != std::string::npos)
+        {
+            candidates = *filteredRows;
+        }
+        else if (auto indexed = trigramIndex != nullptr ? trigramIndex->getCandidates (query) : std::nullopt)
         {
-            row = newRow;
-            columnId = newColumn;
-            toggleButton.setToggleState ((bool) owner.getSelection (row), juce::dontSendNotification);
+            candidates = std::move (*indexed);
+        }
+        else
+        {
+            candidates.resize ((size_t) rowStore.getNumRows());
+            std::iota (candidates.begin(), candidates.end(), 0);
         }
 
-    private:
-        PropertyWndComponent& owner;
-        juce::ToggleButton toggleButton;
-        int row, columnId;
+        auto matchingRows = std::make_shared<std::vector<int>>();
+
+        for (auto storeRow : candidates)
+            if (rowMatchesFilter (storeRow, query))
+                matchingRows->push_back (storeRow);
+
+        filterQuery = std::move (query);
+        showFilteredRows (std::move (matchingRows));
+    }
+
+    /** A condition on the value of a column, like Groups >= 5. Values are compared the way
+        the column sorts, so numbers in text columns compare by value too.
+    */
+    struct Condition
+    {
+        int columnId;
+        ColumnIndex::Comparison comparison;
+        juce::String value;
     };
 
-    class DataSorter
+    /** Narrows the view down to the rows that meet all of some conditions, as well as
+        the filter text. An empty list shows all the rows again.
+
+        Each condition is answered with a binary search of its column's ColumnIndex,
+        which the first query of a column starts building in the background and which
+        is then kept up to date as cells are edited. Until it's ready, the column's rows
+        are checked one by one.
+    */
+    void setQuery (const std::vector<Condition>& newConditions)
     {
-    public:
-        DataSorter (const juce::String& attributeToSortBy, bool forwards)
-            : attributeToSort (attributeToSortBy),
-              direction (forwards ? 1 : -1)
-        {}
+        queryConditions.clear();
 
-        int compareElements (juce::XmlElement* first, juce::XmlElement* second) const
+        for (auto& condition : newConditions)
+            if (getSlotForColumnId (condition.columnId) >= 0)
+                queryConditions.push_back (condition);
+
+        if (queryConditions.empty())
+        {
+            queryRows = nullptr;
+            updateViewFilter();
+            return;
+        }
+
+        std::vector<int> matchingRows;
+
+        for (size_t i = 0; i < queryConditions.size(); ++i)
         {
-            auto result = first->getStringAttribute (attributeToSort)
-                                .compareNatural (second->getStringAttribute (attributeToSort)); // [1]
+            auto rows = findRowsMeeting (queryConditions[i]);
 
-            if (result == 0)
-                result = first->getStringAttribute ("ID")
-                               .compareNatural (second->getStringAttribute ("ID"));             // [2]
+            if (i == 0)
+            {
+                matchingRows = std::move (rows);
+            }
+            else
+            {
+                std::vector<int> intersection;
+                std::set_intersection (matchingRows.begin(), matchingRows.end(), rows.begin(), rows.end(),
+                                       std::back_inserter (intersection));
+                matchingRows = std::move (intersection);
+            }
 
-            return direction * result;                                                          // [3]
+            if (matchingRows.empty())
+                break;
         }
 
-    private:
-        juce::String attributeToSort;
-        int direction;
+        queryRows = std::make_shared<std::vector<int>> (std::move (matchingRows));
+        updateViewFilter();
+    }
+
+    /** Parses conditions like "Groups >= 5 && License == ISC" and passes them to
+        setQuery(). Returns false, leaving the query alone, if the text isn't a list of
+        conditions on columns of the table.
+    */
+    bool setQuery (const juce::String& queryText)
+    {
+        std::vector<Condition> conditions;
+        juce::StringArray clauses;
+        clauses.addTokens (queryText.replace ("&&", "&"), "&", "\"");
+
+        for (auto& clause : clauses)
+        {
+            if (clause.trim().isEmpty())
+                continue;
+
+            auto operatorStart = clause.indexOfAnyOf ("=!<>");
+            auto operatorEnd = operatorStart;
+
+            while (operatorEnd >= 0 && juce::String ("=!<>").containsChar (clause[operatorEnd]))
+                ++operatorEnd;
+
+            auto name = clause.substring (0, operatorStart).trim();
+
+            if (operatorStart <= 0 || name.isEmpty())
+                return false;
+
+            auto slot = rowStore.getSchema().getSlotForName (name);
+            auto comparison = ColumnIndex::parseComparison (clause.substring (operatorStart, operatorEnd));
+
+            if (slot < 0 || ! comparison.has_value())
+                return false;
+
+            conditions.push_back ({ rowStore.getSchema().getColumn (slot).columnId, *comparison,
+                                    clause.substring (operatorEnd).trim().unquoted() });
+        }
+
+        setQuery (conditions);
+        return true;
+    }
+
+    /** Changes the font the cells are drawn with, and measures the columns again for it. */
+    void setFont (const juce::Font& newFont)
+    {
+        font = newFont;
+        glyphLayouts.clear();
+        rowImages.clear();
+        measureAllColumns();
+        tlbObject.repaint();
+    }
+
+    /** Turns on drawing rows from cached images, which makes scrolling back over rows
+        that have been seen before cheaper, at the cost of up to maxBytesOfImages of memory.
+    */
+    void setRowImageCachingEnabled (bool shouldBeEnabled, size_t maxBytesOfImages = 64 * 1024 * 1024)
+    {
+        useRowImages = shouldBeEnabled;
+        rowImages.clear();
+        rowImages.setMaxBytes (maxBytesOfImages);
+        tlbObject.repaint();
+    }
+
+    /** Turns off writing snapshots of the table beside it, for benchmarks and the like
+        that mustn't leave files behind. There's no journal until the first edit, so a
+        component that isn't edited writes nothing at all.
+    */
+    void setSnapshotWritingEnabled (bool shouldBeEnabled) noexcept
+    {
+        shouldWriteSnapshots = shouldBeEnabled;
+    }
+
+    /** Returns true while the table is loading, or while it's being sorted, measured,
+        indexed or snapshotted in the background.
+    */
+    bool isBusy() const noexcept
+    {
+        return loadThread != nullptr || sortPool.getNumJobs() > 0 || backgroundPool.getNumJobs() > 0;
+    }
+
+    juce::TableListBox& getTableListBox() noexcept      { return tlbObject; }
+
+    /** How much painting has been done since resetPaintCounts(). */
+    struct PaintCounts
+    {
+        int numCellsDrawn = 0;
+        int numRowsFromImages = 0;
     };
 
+    const PaintCounts& getPaintCounts() const noexcept  { return paintCounts; }
+    void resetPaintCounts() noexcept                    { paintCounts = {}; }
+
     //==============================================================================
-//! [loadData]
-    void loadData (juce::File tableFile)
+    /** Returns the Select column's flags, indexed by store row. While a table is open
+        they're kept here rather than in the store, and saveData() writes them back.
+    */
+    const SelectionBits& getSelectionFlags() const noexcept     { return selectionFlags; }
+
+    int getNumSelectedRows() const noexcept                     { return selectionFlags.countSet(); }
+
+    void setSelectionOfAllRows (bool shouldBeSelected)
     {
-        if (tableFile == juce::File() || ! tableFile.exists())
+        auto newFlags = selectionFlags;
+        newFlags.setAll (shouldBeSelected);
+        setSelectionFlags (newFlags, shouldBeSelected ? "Tick all rows" : "Untick all rows");
+    }
+
+    void invertSelectionOfAllRows()
+    {
+        auto newFlags = selectionFlags;
+        newFlags.invertAll();
+        setSelectionFlags (newFlags, "Invert ticks");
+    }
+
+    /** Ticks or unticks the Select column of every row in the view, which is what the
+        tick box in its header does.
+    */
+    void setSelectionOfVisibleRows (bool shouldBeSelected)
+    {
+        if (viewOrder.getNumRows() == rowStore.getNumRows())
+        {
+            setSelectionOfAllRows (shouldBeSelected);
             return;
+        }
 
-        tutorialData = juce::XmlDocument::parse (tableFile);            // [3]
+        auto newFlags = selectionFlags;
 
-        dataList   = tutorialData->getChildByName ("DATA");
-        columnList = tutorialData->getChildByName ("HEADERS");          // [4]
+        for (int viewRow = 0; viewRow < viewOrder.getNumRows(); ++viewRow)
+            newFlags.set (viewOrder.getStoreRow (viewRow), shouldBeSelected);
 
-        numRows = dataList->getNumChildElements();                      // [5]
+        setSelectionFlags (newFlags, shouldBeSelected ? "Tick rows" : "Untick rows");
     }
-//! [loadData]
 
-//! [getAttributeNameForColumnId]
-    juce::String getAttributeNameForColumnId (const int columnId) const
+    bool areAllVisibleRowsSelected() const
     {
-        for (auto* columnXml : columnList->getChildIterator())
+        if (viewOrder.getNumRows() == rowStore.getNumRows())
+            return rowStore.getNumRows() > 0 && selectionFlags.areAllSet();
+
+        for (int viewRow = 0; viewRow < viewOrder.getNumRows(); ++viewRow)
+            if (! selectionFlags[viewOrder.getStoreRow (viewRow)])
+                return false;
+
+        return viewOrder.getNumRows() > 0;
+    }
+
+    /** Writes the table back to the file it was loaded from, or to another file, with
+        the Select flags as they are now.
+    */
+    bool saveData (juce::File tableFile = {})
+    {
+        if (tableFile == juce::File())
+            tableFile = loadedFile;
+
+        if (tableFile == juce::File() || loadThread != nullptr)
+            return false;
+
+        finishEditing (true);
+        writeSelectionFlagsToStore();
+
+        auto tableXml = rowStore.createXml ([this] (int row) { return ! removedRows[row]; });
+
+        if (! tableXml->writeTo (tableFile))
+            return false;
+
+        if (tableFile == loadedFile)
+            renumberFileRows();
+
+        const auto stamp = TableSnapshot::getSourceStamp (tableFile);
+
+        if (tableFile == loadedFile)
+        {
+            loadedStamp = stamp;
+            unsavedCells.clear();
+            unsavedFlags.setAll (false);
+
+            if (journal != nullptr)
+                journal->restart (stamp);     // the file has every edit in it now
+        }
+
+        if (shouldWriteSnapshots)
+            backgroundPool.addJob (new SnapshotJob (rowStore, tableFile, stamp, removedRows), true);     // the old one no longer matches the file
+        return true;
+    }
+
+    /** Sets the parallel threshold and thread count used by subsequent sorts. */
+    void setSortOptions (DataSorter::Options newOptions)        { sortOptions = newOptions; }
+
+    /** Returns how long the most recent background sort took. */
+    const DataSorter::Timing& getLastSortTiming() const noexcept { return lastSortTiming; }
+
+    void paintOverChildren (juce::Graphics& g) override
+    {
+        if (pendingSortColumnId == 0)
+            return;
+
+        auto area = getPendingSortIndicatorArea();
+        getLookAndFeel().drawSpinningWaitAnimation (g, getLookAndFeel().findColour (juce::ListBox::textColourId),
+                                                    area.getX(), area.getY(), area.getWidth(), area.getHeight());
+    }
+
+private:
+    juce::TableListBox tlbObject  { {}, this };
+    juce::Font font           { 14.0f };
+
+    TableRowStore rowStore;
+    TableViewOrder viewOrder;
+    SortOrderCache sortCache;
+    std::vector<std::shared_ptr<SortKeyColumn>> sortKeys;   // one per slot, built by the first sort of that slot
+
+    juce::ThreadPool sortPool { 1 };
+    juce::SharedResourcePointer<WorkerThreads> workerThreads;   // kept alive for parallel sorts and loads
+    DataSorter::Options sortOptions;
+    DataSorter::Timing lastSortTiming;
+    int sortGeneration = 0;
+    int pendingSortColumnId = 0;
+    bool pendingSortForwards = true;
+    int idSlot = -1, selectSlot = -1;
+
+    class TableLoadThread;
+    std::unique_ptr<TableLoadThread> loadThread;
+    class TableFileWatcher;
+    std::unique_ptr<TableFileWatcher> fileWatcher;
+    juce::File loadedFile;
+    TableSnapshot::FileInfo loadedStamp;    // the version of the table file that was loaded, or written or read back since
+    juce::ThreadPool backgroundPool { 1 };  // for writing snapshots and measuring columns
+    bool shouldWriteSnapshots = true;
+    ColumnWidthCache columnWidths;
+    int columnWidthGeneration = 0;
+    GlyphLayoutCache glyphLayouts;
+    RowImageCache rowImages;
+    bool useRowImages = false;
+    int rowPaintedFromImage = -1;
+    PaintCounts paintCounts;
+
+   #if TABLE_PROFILING
+    HotPathOverlay profilerOverlay;
+   #endif
+
+    static constexpr int descriptionColumnId = 8, selectColumnId = 9;
+    SelectionBits selectionFlags;       // the Select column, by store row
+
+    /** Lies over the list and takes the clicks that land on a tick box in the Select
+        column, so that they toggle it without reaching the row underneath, which would
+        change the row selection. Like the ToggleButton that used to fill the cell, the
+        whole button area takes the click. Everywhere else clicks go through to the list.
+    */
+    class SelectionBoxClickCatcher  : public juce::Component
+    {
+    public:
+        explicit SelectionBoxClickCatcher (PropertyWndComponent& ownerToUse)
+            : owner (ownerToUse)
+        {
+            setMouseClickGrabsKeyboardFocus (false);
+        }
+
+        bool hitTest (int x, int y) override
+        {
+            return owner.getSelectionBoxRowAt ({ x, y }) >= 0;
+        }
+
+        void mouseDown (const juce::MouseEvent& event) override
         {
-            if (columnXml->getIntAttribute ("columnId") == columnId)
-                return columnXml->getStringAttribute ("name");
+            if (auto row = owner.getSelectionBoxRowAt (event.getPosition()); row >= 0)
+                owner.setSelection (row, owner.getSelection (row) != 0 ? 0 : 1);
         }
 
-        return {};
+    private:
+        PropertyWndComponent& owner;
+    };
+
+    SelectionBoxClickCatcher selectionBoxClickCatcher { *this };   // a child of tlbObject, covering all of it
+
+    juce::TextEditor filterBox;
+    std::string filterQuery;                                // folded, as TrigramIndex matches it
+    TableViewOrder::RowList filteredRows;                   // the store rows matching filterQuery, ascending
+    std::vector<int> filterSlots;                           // the text columns searched by the filter
+    std::shared_ptr<TrigramIndex> trigramIndex;             // built in the background once a table has loaded
+    std::vector<int> rowsEditedWhileIndexing;
+    int indexGeneration = 0;
+
+    std::vector<std::unique_ptr<ColumnIndex>> columnIndexes;   // one per slot, built after the first query of that slot
+    std::vector<int> columnIndexVersions;                   // per slot, changed by every edit, so an index sorted from older cells isn't used
+    std::vector<bool> columnIndexesBeingBuilt;
+    int columnIndexGeneration = 0;
+    std::vector<Condition> queryConditions;
+    TableViewOrder::RowList queryRows;                      // the store rows meeting queryConditions, ascending
+
+    std::shared_ptr<TableJournal> journal;                  // the edits since the table file was written, shared with a compaction;
+                                                            // opened by the first edit, so a table that's only viewed doesn't get one
+    std::vector<TableJournal::Record> journalToReplay;      // read when the table is opened
+    size_t numJournalRecordsReplayed = 0;
+    bool isReplayingJournal = false, isCompactingJournal = false;
+    static constexpr juce::int64 minJournalSizeToCompact = 1 << 20;
+
+    std::map<std::pair<int, int>, juce::String> unsavedCells;  // the text in the file of each cell edited since, by store row and column ID
+    SelectionBits unsavedFlags;             // the Select flags flipped since the file was written or read
+    SelectionBits removedRows;              // rows a reload found gone from the file, which stay in the store but are hidden
+    std::vector<int> fileRows;              // the row in the table file of each store row, or empty while they're the same
+    TableSnapshot::FileInfo failedReloadStamp;
+    int reloadGeneration = 0, numUserEdits = 0;
+    bool isReloading = false, isApplyingReload = false;
+
+    juce::UndoManager undoManager { 1 << 22, 30 };    // its units are changed cells
+    static constexpr int maxCellsToUpdateOneByOne = 256;   // more edits of a column than this rebuild its caches instead
+
+    juce::TextEditor cellEditor;    // shared by every editable cell, and only visible while one is edited
+    int editedStoreRow = -1, editedColumnId = 0;
+
+    struct SortResult
+    {
+        int generation, columnId;
+        TableViewOrder::RowList sortedRows;
+        std::shared_ptr<SortKeyColumn> keys, idKeys;
+        DataSorter::Options options;
+        DataSorter::Timing timing;
+        int indexVersion = -1;      // for a column index, the version of the column it was sorted from
+    };
+
+    /** Sorts a snapshot of the table on the sort pool and hands the result back to the
+        message thread. Any sort keys that don't exist yet are built from copies of the
+        column cells, so the job never touches the live store.
+    */
+    class SortJob  : public juce::ThreadPoolJob
+    {
+    public:
+        SortJob (PropertyWndComponent& owner, SortResult request, int numRowsToSort,
+                 std::vector<juce::String> cellsToSort, std::vector<juce::String> idCells)
+            : juce::ThreadPoolJob ("Table sort"),
+              safeOwner (&owner),
+              result (std::move (request)),
+              numRows (numRowsToSort),
+              sortColumnCells (std::move (cellsToSort)),
+              idColumnCells (std::move (idCells))
+        {}
+
+        JobStatus runJob() override
+        {
+            TABLE_PROFILE_SCOPE ("sortJob");
+
+            if (result.keys == nullptr)
+                result.keys = std::make_shared<SortKeyColumn> (sortColumnCells);
+
+            if (result.idKeys == nullptr && ! idColumnCells.empty())
+                result.idKeys = std::make_shared<SortKeyColumn> (idColumnCells);
+
+            auto sortedRows = std::make_shared<std::vector<int>> ((size_t) numRows);
+            std::iota (sortedRows->begin(), sortedRows->end(), 0);
+
+            DataSorter sorter (result.keys.get(), result.idKeys.get());
+            sorter.setOptions (result.options);
+
+            if (! sorter.sort (*sortedRows, [this] { return shouldExit(); }))
+                return jobHasFinished;
+
+            result.sortedRows = std::move (sortedRows);
+            result.timing = sorter.getLastTiming();
+
+            juce::MessageManager::callAsync ([safeOwner = safeOwner, result = std::move (result)]
+            {
+                if (auto* owner = safeOwner.getComponent())
+                {
+                    if (result.indexVersion >= 0)
+                        owner->columnIndexSorted (result);
+                    else
+                        owner->sortFinished (result);
+                }
+            });
+
+            return jobHasFinished;
+        }
+
+    private:
+        juce::Component::SafePointer<PropertyWndComponent> safeOwner;
+        SortResult result;
+        int numRows;
+        std::vector<juce::String> sortColumnCells, idColumnCells;
+    };
+
+    void startSort (int columnId, bool isForwards)
+    {
+        cancelPendingSort();
+
+        SortResult request { sortGeneration, columnId, nullptr, nullptr, nullptr, sortOptions, {} };
+
+        pendingSortColumnId = columnId;
+        pendingSortForwards = isForwards;
+
+        sortPool.addJob (createSortJob (std::move (request)), true);
+        startTimerHz (30);
+        repaint();
+    }
+
+    /** Creates a job that sorts every row by a column. The sort keys that don't exist yet
+        get made by the job from copies of the cells, except for typed and dictionary-encoded
+        columns, whose keys are quick to copy out of the store.
+    */
+    SortJob* createSortJob (SortResult request)
+    {
+        std::vector<juce::String> cellsToSort, idCells;
+
+        auto getKeysOrCells = [this] (int slotToSort, std::shared_ptr<SortKeyColumn>& keys, std::vector<juce::String>& cells)
+        {
+            keys = sortKeys[(size_t) slotToSort];
+
+            if (keys != nullptr)
+                return;
+
+            keys = makeQuickSortKeys (slotToSort);
+
+            if (keys == nullptr)
+                cells = rowStore.getColumnSnapshot (slotToSort);
+        };
+
+        getKeysOrCells (getSlotForColumnId (request.columnId), request.keys, cellsToSort);
+
+        if (idSlot >= 0)
+            getKeysOrCells (idSlot, request.idKeys, idCells);
+
+        return new SortJob (*this, std::move (request), rowStore.getNumRows(), std::move (cellsToSort), std::move (idCells));
+    }
+
+    void cancelPendingSort()
+    {
+        ++sortGeneration;
+        sortPool.removeAllJobs (true, 0);
+
+        if (pendingSortColumnId != 0)
+        {
+            pendingSortColumnId = 0;
+            stopTimer();
+            repaint();
+        }
+    }
+
+    void sortFinished (const SortResult& result)
+    {
+        if (result.generation != sortGeneration)
+            return;
+
+        lastSortTiming = result.timing;
+
+        installSortKeys (result.columnId, result.keys);
+
+        if (idSlot >= 0 && sortKeys[(size_t) idSlot] == nullptr)
+            sortKeys[(size_t) idSlot] = result.idKeys;
+
+        sortCache.add (result.columnId, result.sortedRows);
+
+        auto isForwards = pendingSortForwards;
+        cancelPendingSort();
+        showSortedRows (result.sortedRows, isForwards);
+    }
+
+    void installSortKeys (int columnId, std::shared_ptr<SortKeyColumn> keys)
+    {
+        auto& existing = sortKeys[(size_t) getSlotForColumnId (columnId)];
+
+        if (existing == nullptr)
+            existing = std::move (keys);
+    }
+
+    void showSortedRows (TableViewOrder::RowList sortedRows, bool isForwards)
+    {
+        auto selectedStoreRows = getSelectedStoreRows();
+
+        finishEditing (true);
+        viewOrder.setSortedRows (std::move (sortedRows), ! isForwards);
+        tlbObject.updateContent();
+        setSelectedStoreRows (selectedStoreRows);
+    }
+
+    void showFilteredRows (TableViewOrder::RowList matchingRows)
+    {
+        filteredRows = std::move (matchingRows);
+        updateViewFilter();
+    }
+
+    /** Shows the rows that match both the filter text and the query. */
+    void updateViewFilter()
+    {
+        auto selectedStoreRows = getSelectedStoreRows();
+
+        finishEditing (true);
+        viewOrder.setFilter (getRowsMatchingFilterAndQuery());
+        tlbObject.updateContent();
+        tlbObject.getHeader().repaint();     // whether all the visible rows are ticked may have changed
+        setSelectedStoreRows (selectedStoreRows);
+    }
+
+    /** Returns the rows that match both the filter text and the query and haven't been
+        removed by a reload, or nullptr for all of them.
+    */
+    TableViewOrder::RowList getRowsMatchingFilterAndQuery() const
+    {
+        TableViewOrder::RowList matchingRows = filteredRows != nullptr ? filteredRows : queryRows;
+
+        if (filteredRows != nullptr && queryRows != nullptr)
+        {
+            auto intersection = std::make_shared<std::vector<int>>();
+            std::set_intersection (filteredRows->begin(), filteredRows->end(), queryRows->begin(), queryRows->end(),
+                                   std::back_inserter (*intersection));
+            matchingRows = std::move (intersection);
+        }
+
+        if (removedRows.countSet() == 0)
+            return matchingRows;
+
+        auto liveRows = std::make_shared<std::vector<int>>();
+
+        if (matchingRows != nullptr)
+        {
+            std::copy_if (matchingRows->begin(), matchingRows->end(), std::back_inserter (*liveRows),
+                          [this] (int row) { return ! removedRows[row]; });
+        }
+        else
+        {
+            for (int row = 0; row < rowStore.getNumRows(); ++row)
+                if (! removedRows[row])
+                    liveRows->push_back (row);
+        }
+
+        return liveRows;
+    }
+
+    bool rowMatchesFilter (int storeRow, const std::string& query) const
+    {
+        juce::String formattedText;
+
+        for (auto slot : filterSlots)
+            if (TrigramIndex::containsFolded (rowStore.getCellText (storeRow, slot, formattedText), query))
+                return true;
+
+        return false;
+    }
+
+    /** Adds or removes edited rows, given in ascending order, from the filtered rows and
+        the query's rows, if they have started or stopped matching them.
+    */
+    void refilterRows (const std::vector<int>& storeRows)
+    {
+        auto filterChanged = filteredRows != nullptr
+                               && updateMembership (filteredRows, storeRows, [this] (int row) { return rowMatchesFilter (row, filterQuery); });
+        auto queryChanged  = queryRows != nullptr
+                               && updateMembership (queryRows, storeRows, [this] (int row) { return rowMeetsQuery (row); });
+
+        if (filterChanged || queryChanged)
+            updateViewFilter();
+    }
+
+    /** Adds some rows to an ascending list of rows or removes them, depending on what
+        shouldContain (row) returns. Returns true if that changed the list.
+    */
+    template <typename Predicate>
+    static bool updateMembership (TableViewOrder::RowList& rows, const std::vector<int>& changedRows, Predicate&& shouldContain)
+    {
+        std::vector<bool> shouldContainRow;
+        shouldContainRow.reserve (changedRows.size());
+        auto anyChanged = false;
+
+        for (auto row : changedRows)
+        {
+            shouldContainRow.push_back (shouldContain (row));
+            anyChanged = anyChanged || std::binary_search (rows->begin(), rows->end(), row) != shouldContainRow.back();
+        }
+
+        if (! anyChanged)
+            return false;
+
+        // merge the changed rows into the unchanged runs between them
+        auto newRows = std::make_shared<std::vector<int>>();
+        newRows->reserve (rows->size() + changedRows.size());
+        auto next = rows->cbegin();
+
+        for (size_t i = 0; i < changedRows.size(); ++i)
+        {
+            auto position = std::lower_bound (next, rows->cend(), changedRows[i]);
+            newRows->insert (newRows->end(), next, position);
+            next = (position != rows->cend() && *position == changedRows[i]) ? position + 1 : position;
+
+            if (shouldContainRow[i])
+                newRows->push_back (changedRows[i]);
+        }
+
+        newRows->insert (newRows->end(), next, rows->cend());
+        rows = std::move (newRows);
+        return true;
+    }
+
+    //==============================================================================
+    /** Returns a function that compares a row's value in a column with some value, in
+        the column's sort order.
+    */
+    std::function<int (int)> getComparisonWith (int slot, const juce::String& value) const
+    {
+        auto compareKeys = [] (juce::uint64 a, juce::uint64 b) { return a < b ? -1 : (a > b ? 1 : 0); };
+
+        if (slot == selectSlot)
+        {
+            auto key = TypedColumn::getSortKey (TableColumnSchema::ColumnType::boolean, value);
+            return [this, key, compareKeys] (int row) { return compareKeys (getSelectionSortKey (row), key); };
+        }
+
+        if (rowStore.hasSortKeys (slot))
+        {
+            auto key = rowStore.getSortKeyFor (slot, value);
+            return [this, slot, key, compareKeys] (int row) { return compareKeys (rowStore.getSortKey (row, slot), key); };
+        }
+
+        auto valueKey = std::make_shared<std::vector<char>>();
+        SortKeyColumn::encode (value, *valueKey);
+
+        return [this, slot, valueKey] (int row)
+        {
+            std::vector<char> rowKey;
+            SortKeyColumn::encode (rowStore.getCell (row, slot), rowKey);
+            return SortKeyColumn::compareEncoded (rowKey, *valueKey);
+        };
+    }
+
+    /** Finds the rows that meet a condition, in ascending order. Until the column has an
+        index, which isn't built while the table is still loading, its rows are checked one
+        by one instead.
+    */
+    std::vector<int> findRowsMeeting (const Condition& condition)
+    {
+        auto slot = getSlotForColumnId (condition.columnId);
+        auto compareWithValue = getComparisonWith (slot, condition.value);
+
+        if (loadThread == nullptr)
+        {
+            if (auto& index = columnIndexes[(size_t) slot])
+                return index->findRows (condition.comparison, compareWithValue);
+
+            buildColumnIndex (slot);
+        }
+
+        std::vector<int> rows;
+
+        for (int row = 0; row < rowStore.getNumRows(); ++row)
+            if (ColumnIndex::satisfies (condition.comparison, compareWithValue (row)))
+                rows.push_back (row);
+
+        return rows;
+    }
+
+    bool rowMeetsQuery (int storeRow) const
+    {
+        for (auto& condition : queryConditions)
+            if (! ColumnIndex::satisfies (condition.comparison,
+                                          getComparisonWith (getSlotForColumnId (condition.columnId), condition.value) (storeRow)))
+                return false;
+
+        return true;
+    }
+
+    /** Returns the sort keys of a column that can be made without encoding any text, or
+        nullptr for a text column.
+    */
+    std::shared_ptr<SortKeyColumn> makeQuickSortKeys (int slot) const
+    {
+        if (slot == selectSlot)
+            return std::make_shared<SortKeyColumn> (getSelectionSortKeys());
+
+        if (rowStore.hasSortKeys (slot))
+            return std::make_shared<SortKeyColumn> (rowStore.getSortKeys (slot));
+
+        return nullptr;
+    }
+
+    /** Returns the sort keys of a column, making them on this thread if there aren't any yet. */
+    std::shared_ptr<SortKeyColumn> getSortKeysNow (int slot)
+    {
+        auto& keys = sortKeys[(size_t) slot];
+
+        if (keys == nullptr)
+            keys = makeQuickSortKeys (slot);
+
+        if (keys == nullptr)
+            keys = std::make_shared<SortKeyColumn> (rowStore.getColumnSnapshot (slot));
+
+        return keys;
+    }
+
+    /** Starts sorting a column for its index on the background pool, unless it's being
+        sorted already.
+    */
+    void buildColumnIndex (int slot)
+    {
+        if (columnIndexesBeingBuilt[(size_t) slot])
+            return;
+
+        columnIndexesBeingBuilt[(size_t) slot] = true;
+
+        SortResult request { columnIndexGeneration, rowStore.getSchema().getColumn (slot).columnId,
+                             nullptr, nullptr, nullptr, sortOptions, {}, columnIndexVersions[(size_t) slot] };
+        backgroundPool.addJob (createSortJob (std::move (request)), true);
+    }
+
+    void columnIndexSorted (const SortResult& result)
+    {
+        if (result.generation != columnIndexGeneration)
+            return;
+
+        auto slot = getSlotForColumnId (result.columnId);
+        columnIndexesBeingBuilt[(size_t) slot] = false;
+
+        if (result.indexVersion != columnIndexVersions[(size_t) slot])
+        {
+            buildColumnIndex (slot);    // edited while it was being sorted
+            return;
+        }
+
+        installSortKeys (result.columnId, result.keys);
+
+        if (idSlot >= 0 && sortKeys[(size_t) idSlot] == nullptr)
+            sortKeys[(size_t) idSlot] = result.idKeys;
+
+        columnIndexes[(size_t) slot] = std::make_unique<ColumnIndex> (*result.sortedRows);
+    }
+
+    /** Marks a column as changed, so that an index being sorted from its old cells gets
+        sorted again. An edited ID can change where the rows of every other column fall
+        among their equals, so it changes them all.
+    */
+    void columnChangedForIndexes (int slot)
+    {
+        for (size_t i = 0; i < columnIndexVersions.size(); ++i)
+            if ((int) i == slot || slot == idSlot)
+                ++columnIndexVersions[i];
+    }
+
+    /** Patches an edited row's sort key, moving the row to its new place in its column's
+        index on the way. The row is found in the index by its old key, so this has to be
+        called once for each edited row, before its key has been updated. An edited ID
+        drops the other columns' indexes.
+    */
+    void updateSortKeyAndIndex (int storeRow, int slot)
+    {
+        if (slot == idSlot)
+            for (size_t i = 0; i < columnIndexes.size(); ++i)
+                if ((int) i != slot)
+                    columnIndexes[i] = nullptr;
+
+        auto& index = columnIndexes[(size_t) slot];
+
+        if (index != nullptr && sortKeys[(size_t) slot] == nullptr)
+            index = nullptr;    // without the old keys, the row can't be found
+
+        if (index == nullptr)
+        {
+            updateSortKey (storeRow, slot);
+            return;
+        }
+
+        // raw pointers, so that updateSortKey() doesn't see the keys as shared and copy them
+        auto getSorter = [this, slot]
+        {
+            return DataSorter (sortKeys[(size_t) slot].get(),
+                               idSlot >= 0 && idSlot != slot ? getSortKeysNow (idSlot).get() : sortKeys[(size_t) slot].get());
+        };
+
+        auto oldSorter = getSorter();
+        auto position = index->findPosition (storeRow, [&oldSorter] (int a, int b) { return oldSorter.compareElements (a, b) < 0; });
+
+        updateSortKey (storeRow, slot);
+
+        if (position < 0)
+        {
+            jassertfalse;   // the index and the old keys disagree
+            index = nullptr;
+            return;
+        }
+
+        auto newSorter = getSorter();
+        index->moveRow (position, [&newSorter] (int a, int b) { return newSorter.compareElements (a, b) < 0; });
+    }
+
+    //==============================================================================
+    /** Builds a TrigramIndex of the text columns on the background pool, from copies of
+        their cells, and hands it to the message thread.
+    */
+    class TrigramIndexJob  : public juce::ThreadPoolJob
+    {
+    public:
+        TrigramIndexJob (PropertyWndComponent& owner, int generationToReport,
+                         std::vector<std::vector<juce::String>> columnsToIndex, int numRowsToIndex)
+            : juce::ThreadPoolJob ("Trigram index"),
+              safeOwner (&owner),
+              generation (generationToReport),
+              columns (std::move (columnsToIndex)),
+              numRows (numRowsToIndex)
+        {}
+
+        JobStatus runJob() override
+        {
+            auto index = std::make_shared<TrigramIndex>();
+
+            if (! index->build (columns, numRows, [this] { return shouldExit(); }))
+                return jobHasFinished;
+
+            juce::MessageManager::callAsync ([safeOwner = safeOwner, generation = generation, index = std::move (index)]
+            {
+                if (auto* owner = safeOwner.getComponent())
+                    owner->trigramIndexBuilt (generation, index);
+            });
+
+            return jobHasFinished;
+        }
+
+    private:
+        juce::Component::SafePointer<PropertyWndComponent> safeOwner;
+        int generation;
+        std::vector<std::vector<juce::String>> columns;
+        int numRows;
+    };
+
+    void startIndexing()
+    {
+        std::vector<std::vector<juce::String>> columns;
+
+        for (auto slot : filterSlots)
+            columns.push_back (rowStore.getColumnSnapshot (slot));
+
+        rowsEditedWhileIndexing.clear();
+        backgroundPool.addJob (new TrigramIndexJob (*this, ++indexGeneration, std::move (columns), rowStore.getNumRows()), true);
+    }
+
+    void trigramIndexBuilt (int generation, std::shared_ptr<TrigramIndex> index)
+    {
+        if (generation != indexGeneration)
+            return;
+
+        for (auto storeRow : rowsEditedWhileIndexing)
+            index->addChangedRow (storeRow);
+
+        rowsEditedWhileIndexing.clear();
+        trigramIndex = std::move (index);
+    }
+
+    juce::Rectangle<int> getPendingSortIndicatorArea() const
+    {
+        auto& header = tlbObject.getHeader();
+        auto columnArea = getLocalArea (&header, header.getColumnPosition (header.getIndexOfColumnId (pendingSortColumnId, true)));
+        auto size = columnArea.getHeight() - 6;
+
+        return columnArea.removeFromRight (columnArea.getHeight() * 2).removeFromLeft (columnArea.getHeight())
+                         .withSizeKeepingCentre (size, size);
+    }
+
+    void drawRowBackground (juce::Graphics& g, int rowNumber, bool rowIsSelected)
+    {
+        auto alternateColour = getLookAndFeel().findColour (juce::ListBox::backgroundColourId)
+                                               .interpolatedWith (getLookAndFeel().findColour (juce::ListBox::textColourId), 0.03f);
+        if (rowIsSelected)
+            g.fillAll (juce::Colours::lightblue);
+        else if (rowNumber % 2)
+            g.fillAll (alternateColour);
+    }
+
+    void drawCell (juce::Graphics& g, int rowNumber, int columnId,
+                   int width, int height, bool rowIsSelected)
+    {
+        if (columnId == selectColumnId)
+        {
+            drawSelectionBox (g, rowNumber, height);
+        }
+        else
+        {
+            drawText (g, rowNumber, columnId, width, height, rowIsSelected);
+        }
+
+        g.setColour (getLookAndFeel().findColour (juce::ListBox::backgroundColourId));
+        g.fillRect (width - 1, 0, 1, height);                                                                               // [7]
+    }
+
+    void drawText (juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
+    {
+        g.setColour (rowIsSelected ? juce::Colours::darkblue : getLookAndFeel().findColour (juce::ListBox::textColourId));  // [5]
+        g.setFont (font);
+
+        auto storeRow = viewOrder.getStoreRow (rowNumber);
+
+        if (storeRow >= 0)
+        {
+            juce::String formattedText;
+            auto text = rowStore.getCellText (storeRow, getSlotForColumnId (columnId), formattedText);
+
+            if (text.isNotEmpty())
+                glyphLayouts.getLayout (text, font, { 2, 0, width - 4, height }, juce::Justification::centredLeft).draw (g);   // [6]
+        }
+    }
+
+    /** Returns the row whose Select button is at a position in the list, or -1 if there
+        isn't one there.
+    */
+    int getSelectionBoxRowAt (juce::Point<int> position) const
+    {
+        auto& viewport = *tlbObject.getViewport();
+
+        if (! viewport.getBounds().withWidth (viewport.getMaximumVisibleWidth())
+                                  .withHeight (viewport.getMaximumVisibleHeight()).contains (position))
+            return -1;      // over the header or a scroll bar
+
+        auto row = tlbObject.getRowContainingPosition (position.x, position.y);
+
+        if (viewOrder.getStoreRow (row) < 0
+             || ! tlbObject.getCellPosition (selectColumnId, row, true).reduced (2).contains (position))
+            return -1;
+
+        return row;
+    }
+
+    /** Draws the tick box the way the ToggleButton that used to fill the cell drew it. */
+    void drawSelectionBox (juce::Graphics& g, int rowNumber, int height)
+    {
+        if (viewOrder.getStoreRow (rowNumber) < 0)
+            return;
+
+        auto buttonHeight = (float) (height - 4);
+        auto boxSize = juce::jmin (15.0f, buttonHeight * 0.75f) * 1.1f;
+
+        getLookAndFeel().drawTickBox (g, tlbObject, 6.0f, 2.0f + (buttonHeight - boxSize) * 0.5f, boxSize, boxSize,
+                                      getSelection (rowNumber) != 0, isEnabled(), false, false);
+    }
+
+    /** Draws a row from its cached image, rendering the image first if there isn't one.
+        Returns false if the row can't be cached, so it gets painted normally.
+    */
+    bool paintRowFromImage (juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected)
+    {
+        auto storeRow = viewOrder.getStoreRow (rowNumber);
+
+        if (storeRow < 0 || width <= 0 || height <= 0)
+            return false;
+
+        auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        RowImageCache::Key key { storeRow, rowIsSelected, (rowNumber % 2) != 0, width, height, scale };
+        auto image = rowImages.find (key);
+
+        if (image.isNull())
+        {
+            image = renderRowImage (rowNumber, width, height, rowIsSelected, scale);
+            rowImages.add (key, image);
+        }
+
+        g.drawImageTransformed (image, juce::AffineTransform::scale (1.0f / scale));
+        return true;
+    }
+
+    /** Paints a row the way the TableListBox would. */
+    juce::Image renderRowImage (int rowNumber, int width, int height, bool rowIsSelected, float scale)
+    {
+        juce::Image image (juce::Image::ARGB, juce::roundToInt ((float) width * scale),
+                           juce::roundToInt ((float) height * scale), true);
+        juce::Graphics g (image);
+        g.addTransform (juce::AffineTransform::scale (scale));
+
+        drawRowBackground (g, rowNumber, rowIsSelected);
+
+        auto& header = tlbObject.getHeader();
+
+        for (int i = 0; i < header.getNumColumns (true); ++i)
+        {
+            auto columnId = header.getColumnIdOfIndex (i, true);
+            auto columnArea = header.getColumnPosition (i).withHeight (height);
+            juce::Graphics::ScopedSaveState state (g);
+
+            if (g.reduceClipRegion (columnArea))
+            {
+                g.setOrigin (columnArea.getX(), 0);
+                drawCell (g, rowNumber, columnId, columnArea.getWidth(), height, rowIsSelected);
+            }
+        }
+
+        return image;
+    }
+
+    //==============================================================================
+    /** A header that shows a tick box in place of the Select column's title. Clicking it
+        ticks or unticks every visible row, rather than sorting by the column.
+    */
+    class SelectionHeader  : public juce::TableHeaderComponent
+    {
+    public:
+        explicit SelectionHeader (PropertyWndComponent& ownerToControl)
+            : owner (ownerToControl)
+        {}
+
+        void columnClicked (int columnId, const juce::ModifierKeys& mods) override
+        {
+            if (columnId == selectColumnId)
+                owner.setSelectionOfVisibleRows (! owner.areAllVisibleRowsSelected());
+            else
+                juce::TableHeaderComponent::columnClicked (columnId, mods);
+        }
+
+        void paint (juce::Graphics& g) override
+        {
+            juce::TableHeaderComponent::paint (g);
+
+            auto index = getIndexOfColumnId (selectColumnId, true);
+
+            if (index < 0)
+                return;
+
+            auto area = getColumnPosition (index).toFloat();
+            auto boxSize = juce::jmin (15.0f, area.getHeight() * 0.75f) * 1.1f;
+
+            getLookAndFeel().drawTickBox (g, *this, area.getX() + 6.0f, area.getCentreY() - boxSize * 0.5f, boxSize, boxSize,
+                                          owner.areAllVisibleRowsSelected(), isEnabled(), false, false);
+        }
+
+    private:
+        PropertyWndComponent& owner;
+    };
+
+    /** Sort keys for the Select column, in the same order as its typed keys. */
+    juce::uint64 getSelectionSortKey (int storeRow) const noexcept
+    {
+        return selectionFlags[storeRow] ? 2 : 1;
+    }
+
+    std::vector<juce::uint64> getSelectionSortKeys() const
+    {
+        std::vector<juce::uint64> keys;
+        keys.reserve ((size_t) rowStore.getNumRows());
+
+        for (int row = 0; row < rowStore.getNumRows(); ++row)
+            keys.push_back (getSelectionSortKey (row));
+
+        return keys;
+    }
+
+    /** Forgets the sorted orders and index that depended on the Select flags, after many
+        of them have changed, and repaints every row.
+    */
+    void selectionFlagsChanged()
+    {
+        if (selectSlot >= 0)
+        {
+            sortKeys[(size_t) selectSlot] = nullptr;
+            columnIndexes[(size_t) selectSlot] = nullptr;
+            columnChangedForIndexes (selectSlot);
+        }
+
+        rowImages.clear();
+        tlbObject.repaint();
+
+        if (! queryConditions.empty())
+            setQuery (std::vector<Condition> (queryConditions));
+
+        sortCache.invalidateColumn (selectColumnId);
+
+        if (pendingSortColumnId != 0)
+            startSort (pendingSortColumnId, pendingSortForwards);
+    }
+
+    /** The undo record of a bulk change to the Select flags: just the flags that flipped. */
+    class SelectionFlagsAction  : public juce::UndoableAction
+    {
+    public:
+        SelectionFlagsAction (PropertyWndComponent& ownerToChange, SelectionBits flagsToFlip)
+            : owner (ownerToChange), flippedFlags (std::move (flagsToFlip))
+        {}
+
+        bool perform() override                 { owner.flipSelectionFlags (flippedFlags); return true; }
+        bool undo() override                    { return perform(); }
+        int getSizeInUnits() override           { return flippedFlags.size() / 64 + 1; }
+
+    private:
+        PropertyWndComponent& owner;
+        SelectionBits flippedFlags;
+    };
+
+    void flipSelectionFlags (const SelectionBits& flippedFlags)
+    {
+        selectionFlags ^= flippedFlags;
+
+        if (! isApplyingReload)
+            unsavedFlags ^= flippedFlags;
+
+        if (isUserEdit())
+        {
+            ++numUserEdits;
+
+            getJournal().addFlippedFlags (getFlagsByFileRow (flippedFlags));
+            compactJournalIfNeeded();
+        }
+
+        selectionFlagsChanged();
+    }
+
+    void setSelectionFlags (SelectionBits newFlags, const juce::String& transactionName)
+    {
+        newFlags ^= selectionFlags;
+
+        if (newFlags.countSet() == 0)
+            return;
+
+        finishEditing (true);
+        undoManager.beginNewTransaction (transactionName);
+        undoManager.perform (new SelectionFlagsAction (*this, std::move (newFlags)));
+    }
+
+    /** Reads the Select flags of rows that have just been loaded. */
+    void readSelectionFlags()
+    {
+        auto firstNewRow = selectionFlags.size();
+        selectionFlags.resize (rowStore.getNumRows());
+        unsavedFlags.resize (rowStore.getNumRows());
+
+        if (selectSlot >= 0)
+            for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+                selectionFlags.set (row, rowStore.getBoolean (row, selectSlot));
+    }
+
+    /** Copies the Select flags into the store, only touching the cells that differ so
+        that the others keep their original text.
+    */
+    void writeSelectionFlagsToStore()
+    {
+        if (selectSlot < 0)
+            return;
+
+        for (int row = 0; row < rowStore.getNumRows(); ++row)
+            if (auto isSelected = selectionFlags[row]; isSelected != rowStore.getBoolean (row, selectSlot))
+                rowStore.setCell (row, selectSlot, isSelected ? "1" : "0");
+    }
+
+    void lookAndFeelChanged() override
+    {
+        rowImages.clear();
+    }
+
+    void tableColumnsChanged (juce::TableHeaderComponent*) override     { columnLayoutChanged(); }
+    void tableColumnsResized (juce::TableHeaderComponent*) override     { columnLayoutChanged(); }
+    void tableSortOrderChanged (juce::TableHeaderComponent*) override   {}
+
+    void columnLayoutChanged()
+    {
+        auto& header = tlbObject.getHeader();
+        std::vector<int> textWidths;
+
+        for (int i = 0; i < header.getNumColumns (true); ++i)
+            textWidths.push_back (header.getColumnWidth (header.getColumnIdOfIndex (i, true)) - 4);
+
+        glyphLayouts.removeWidthsOtherThan (textWidths);
+        rowImages.clear();
+        finishEditing (true);
+    }
+
+    void scrollBarMoved (juce::ScrollBar*, double) override
+    {
+        finishEditing (true);   // rather than leave the editor floating over another cell
+    }
+
+    //==============================================================================
+    /** Opens the shared editor over a cell. The edit is tied to the store row, so it
+        still lands in the right place if the rows get re-sorted meanwhile.
+    */
+    void showCellEditor (int rowNumber, int columnId)
+    {
+        finishEditing (true);
+
+        editedStoreRow = viewOrder.getStoreRow (rowNumber);
+        editedColumnId = columnId;
+
+        if (editedStoreRow < 0)
+            return;
+
+        cellEditor.setFont (font);
+        cellEditor.setText (getText (columnId, rowNumber), false);
+        cellEditor.setBounds (getLocalArea (&tlbObject, tlbObject.getCellPosition (columnId, rowNumber, true)));
+        cellEditor.setVisible (true);
+        cellEditor.grabKeyboardFocus();
+        cellEditor.selectAll();
+    }
+
+    /** Hides the editor, writing its text back to the cell through setText() if it was
+        changed and shouldCommit is true.
+    */
+    void finishEditing (bool shouldCommit)
+    {
+        if (editedStoreRow < 0)
+            return;
+
+        auto storeRow = std::exchange (editedStoreRow, -1);     // hiding the editor calls onFocusLost
+        cellEditor.setVisible (false);
+
+        if (! shouldCommit)
+            return;
+
+        auto viewRow = viewOrder.getViewRow (storeRow);
+        auto newText = cellEditor.getText();
+
+        if (viewRow >= 0 && newText != getText (editedColumnId, viewRow))
+            setText (editedColumnId, viewRow, newText);
+    }
+
+    void timerCallback() override
+    {
+        repaint (getPendingSortIndicatorArea());
+    }
+
+    //==============================================================================
+    /** Reads a table file with TableDataReader::readFile() and passes whatever it has
+        read so far to the message thread, a batch of rows at a time.
+    */
+    class TableLoadThread  : public juce::Thread
+    {
+    public:
+        TableLoadThread (PropertyWndComponent& ownerToNotify, const juce::File& fileToRead)
+            : juce::Thread ("Table loader"),
+              owner (ownerToNotify),
+              file (fileToRead),
+              workers (*ownerToNotify.workerThreads)
+        {}
+
+        ~TableLoadThread() override
+        {
+            stopThread (4000);
+        }
+
+        struct Progress
+        {
+            std::unique_ptr<TableColumnSchema> schema;
+            std::vector<std::pair<std::vector<juce::String>, int>> batches;    // cells and number of rows
+            bool finished = false;
+            juce::String error;
+        };
+
+        /** Takes everything that has been read since the last call. */
+        Progress takeProgress()
+        {
+            const juce::ScopedLock sl (lock);
+            return std::exchange (progress, {});
+        }
+
+        void run() override
+        {
+            TABLE_PROFILE_SCOPE ("loadThread");
+            TableDataReader reader;
+
+            reader.onSchemaRead = [this] (const TableColumnSchema& schema)
+            {
+                const juce::ScopedLock sl (lock);
+                progress.schema = std::make_unique<TableColumnSchema> (schema);
+                owner.triggerAsyncUpdate();
+            };
+
+            reader.onRowsRead = [this] (std::vector<juce::String>&& cells, int numRows)
+            {
+                const juce::ScopedLock sl (lock);
+                progress.batches.emplace_back (std::move (cells), numRows);
+                owner.triggerAsyncUpdate();
+            };
+
+            reader.shouldExit = [this] { return threadShouldExit(); };
+
+            auto ok = reader.readFile (file, workers);
+
+            const juce::ScopedLock sl (lock);
+            progress.finished = true;
+            progress.error = ok ? juce::String() : reader.getLastError();
+            owner.triggerAsyncUpdate();
+        }
+
+    private:
+        PropertyWndComponent& owner;
+        const juce::File file;
+        WorkerThreads& workers;
+        juce::CriticalSection lock;
+        Progress progress;
+
+        JUCE_DECLARE_NON_COPYABLE (TableLoadThread)
+    };
+
+    /** Writes a TableSnapshot of a table file from a copy of the store that holds the same
+        rows, so that the next time the file is opened it can be mapped instead of parsed.
+    */
+    class SnapshotJob  : public juce::ThreadPoolJob
+    {
+    public:
+        SnapshotJob (TableRowStore storeToWrite, const juce::File& tableFile,
+                     const TableSnapshot::FileInfo& tableStamp, SelectionBits rowsToSkip = {})
+            : juce::ThreadPoolJob ("Table snapshot"),
+              store (std::move (storeToWrite)),
+              file (tableFile),
+              stamp (tableStamp),
+              skippedRows (std::move (rowsToSkip))
+        {}
+
+        JobStatus runJob() override
+        {
+            std::function<bool (int)> shouldWriteRow;
+
+            if (skippedRows.countSet() > 0)
+                shouldWriteRow = [this] (int row) { return ! skippedRows[row]; };
+
+            if (! store.writeSnapshot (TableSnapshot::getFileFor (file), stamp, shouldWriteRow))
+                DBG ("Couldn't write a snapshot of " << file.getFullPathName());
+
+            return jobHasFinished;
+        }
+
+    private:
+        const TableRowStore store;
+        const juce::File file;
+        const TableSnapshot::FileInfo stamp;
+        const SelectionBits skippedRows;
+    };
+
+    /** Folds the journal into a new table file. The file is made from the old one and the
+        journal's edits rather than from the table on screen, so that the Select flags
+        and edits go in exactly as the journal has them.
+    */
+    class JournalCompactionJob  : public juce::ThreadPoolJob
+    {
+    public:
+        JournalCompactionJob (PropertyWndComponent& owner, std::shared_ptr<TableJournal> journalToCompact,
+                              const juce::File& fileToRewrite)
+            : juce::ThreadPoolJob ("Journal compaction"),
+              safeOwner (&owner),
+              journal (std::move (journalToCompact)),
+              file (fileToRewrite)
+        {}
+
+        JobStatus runJob() override
+        {
+            auto compaction = journal->startCompaction();
+            TableRowStore store;
+            auto compacted = false;
+
+            if (store.loadFromFile (file, [this] { return shouldExit(); }))
+            {
+                applyJournal (store, compaction.records);
+
+                juce::TemporaryFile newFile (file);
+                compacted = store.createXml()->writeTo (newFile.getFile())
+                              && journal->finishCompaction (newFile, compaction);
+
+                // the old snapshot no longer matches the file, and this store holds what's in it now
+                if (compacted && ! store.writeSnapshot (TableSnapshot::getFileFor (file), TableSnapshot::getSourceStamp (file)))
+                    DBG ("Couldn't write a snapshot of " << file.getFullPathName());
+            }
+
+            juce::MessageManager::callAsync ([safeOwner = safeOwner]
+            {
+                if (auto* owner = safeOwner.getComponent())
+                    owner->journalCompacted();
+            });
+
+            return jobHasFinished;
+        }
+
+    private:
+        juce::Component::SafePointer<PropertyWndComponent> safeOwner;
+        std::shared_ptr<TableJournal> journal;
+        const juce::File file;
+    };
+
+    /** Applies a journal's edits straight to a store, flipping the text of its Select column. */
+    static void applyJournal (TableRowStore& store, const std::vector<TableJournal::Record>& records)
+    {
+        auto& schema = store.getSchema();
+        auto storeIdSlot = schema.getSlotForName ("ID");
+        auto storeSelectSlot = schema.getSlotForName ("Select");
+        std::unordered_map<juce::String, int> rowsById;
+
+        for (auto& record : records)
+        {
+            if (record.isFlippedFlags())
+            {
+                if (storeSelectSlot >= 0)
+                    for (auto row : record.flippedFlags)
+                        if (row < store.getNumRows())
+                            store.setCell (row, storeSelectSlot, store.getBoolean (row, storeSelectSlot) ? "0" : "1");
+
+                continue;
+            }
+
+            auto slot = schema.getSlotForColumnId (record.columnId);
+            auto row = findJournalRow (store, storeIdSlot, record, rowsById);
+
+            if (slot >= 0 && row >= 0)
+                store.setCell (row, slot, record.text);
+
+            if (slot == storeIdSlot)
+                rowsById.clear();
+        }
+    }
+
+    /** Finds the store row that a journal record edits. It's normally the row it recorded,
+        but if that row's ID doesn't match, the row with the ID is looked for instead.
+        Returns -1 if there's no such row.
+    */
+    static int findJournalRow (const TableRowStore& store, int storeIdSlot, const TableJournal::Record& record,
+                               std::unordered_map<juce::String, int>& rowsById)
+    {
+        if (storeIdSlot < 0)
+            return juce::isPositiveAndBelow (record.storeRow, store.getNumRows()) ? record.storeRow : -1;
+
+        if (juce::isPositiveAndBelow (record.storeRow, store.getNumRows())
+             && store.getCell (record.storeRow, storeIdSlot) == record.rowId)
+            return record.storeRow;
+
+        if (rowsById.empty())
+            for (int row = store.getNumRows(); --row >= 0;)
+                rowsById[store.getCell (row, storeIdSlot)] = row;      // the first row wins, as it would in a search
+
+        auto found = rowsById.find (record.rowId);
+        return found != rowsById.end() ? found->second : -1;
+    }
+
+    /** Applies the edits read from the table's journal, in the order they were made, to
+        the rows that have loaded so far. Replaying stops at the first edit of a row that
+        hasn't loaded yet, and carries on from there when more rows arrive.
+    */
+    void replayJournal (bool allRowsLoaded)
+    {
+        const juce::ScopedValueSetter<bool> replaying (isReplayingJournal, true);
+        std::vector<CellChange> changes;
+        std::unordered_map<juce::String, int> rowsById;
+
+        for (; numJournalRecordsReplayed < journalToReplay.size(); ++numJournalRecordsReplayed)
+        {
+            auto& record = journalToReplay[numJournalRecordsReplayed];
+
+            if (record.isFlippedFlags())
+            {
+                if (! allRowsLoaded && record.flippedFlags.size() > rowStore.getNumRows())
+                    break;
+
+                applyCellChanges (changes, false);
+                changes.clear();
+                flipSelectionFlags (record.flippedFlags);
+                continue;
+            }
+
+            auto isLoaded = juce::isPositiveAndBelow (record.storeRow, rowStore.getNumRows())
+                              && (idSlot < 0 || rowStore.getCell (record.storeRow, idSlot) == record.rowId);
+
+            if (! isLoaded && ! allRowsLoaded)
+                break;
+
+            if (auto storeRow = isLoaded ? record.storeRow : findJournalRow (rowStore, idSlot, record, rowsById); storeRow >= 0)
+                changes.push_back ({ storeRow, record.columnId, {}, record.text });
+
+            if (getSlotForColumnId (record.columnId) == idSlot)
+            {
+                // later records find their rows by the new ID
+                applyCellChanges (changes, false);
+                changes.clear();
+                rowsById.clear();
+            }
+        }
+
+        applyCellChanges (changes, false);
+
+        if (allRowsLoaded)
+            journalToReplay = {};
+    }
+
+    /** Returns the journal that edits are written to, opening it for the first one. */
+    TableJournal& getJournal()
+    {
+        if (journal == nullptr)
+            journal = std::make_shared<TableJournal> (loadedFile, loadedStamp);
+
+        return *journal;
+    }
+
+    void compactJournalIfNeeded()
+    {
+        if (journal == nullptr || isCompactingJournal || isReplayingJournal || loadThread != nullptr
+             || journal->getSize() < juce::jmax (minJournalSizeToCompact, loadedFile.getSize() / 4))
+            return;
+
+        isCompactingJournal = true;
+        backgroundPool.addJob (new JournalCompactionJob (*this, journal, loadedFile), true);
+    }
+
+    void journalCompacted()
+    {
+        isCompactingJournal = false;
+    }
+
+    /** Edits made in the table get counted and journaled. The ones replayed from the
+        journal or read back from the table file don't.
+    */
+    bool isUserEdit() const noexcept    { return ! isReplayingJournal && ! isApplyingReload; }
+
+    int getFileRow (int storeRow) const noexcept
+    {
+        if (fileRows.empty())
+            return storeRow;
+
+        return juce::isPositiveAndBelow (storeRow, (int) fileRows.size()) ? fileRows[(size_t) storeRow] : -1;
+    }
+
+    /** Converts flags indexed by store row into flags indexed by row of the table file. */
+    SelectionBits getFlagsByFileRow (const SelectionBits& flags) const
+    {
+        if (fileRows.empty())
+            return flags;
+
+        SelectionBits flagsByFileRow;
+        flagsByFileRow.resize (rowStore.getNumRows() - removedRows.countSet());
+
+        for (auto storeRow : flags)
+            flagsByFileRow.set (getFileRow (storeRow), true);
+
+        return flagsByFileRow;
+    }
+
+    /** After the table has been written without its removed rows, the rest are numbered
+        in store order.
+    */
+    void renumberFileRows()
+    {
+        fileRows.clear();
+
+        if (removedRows.countSet() == 0)
+            return;
+
+        for (int row = 0, fileRow = 0; row < rowStore.getNumRows(); ++row)
+            fileRows.push_back (removedRows[row] ? -1 : fileRow++);
+    }
+
+    //==============================================================================
+    /** Polls the table file, and has it read again once something else has written it
+        and it has stopped changing.
+    */
+    class TableFileWatcher  : private juce::Timer
+    {
+    public:
+        explicit TableFileWatcher (PropertyWndComponent& ownerToNotify)
+            : owner (ownerToNotify)
+        {
+            startTimer (pollIntervalMs);
+        }
+
+    private:
+        static constexpr int pollIntervalMs = 1000;
+
+        PropertyWndComponent& owner;
+        TableSnapshot::FileInfo lastStamp;
+
+        void timerCallback() override
+        {
+            auto stamp = TableSnapshot::getSourceStamp (owner.loadedFile);
+
+            if (stamp == std::exchange (lastStamp, stamp))
+                owner.tableFileMayHaveChanged (stamp);
+        }
+    };
+
+    /** Everything a reload has found different in the table file. Rows are matched up by
+        their ID, and the rows that are still there keep their store rows.
+    */
+    struct Reload
+    {
+        int generation = 0, numUserEditsBefore = 0;
+        TableSnapshot::FileInfo stamp;
+        bool wasRead = false, needsFullLoad = false;
+        std::vector<CellChange> changes;
+        std::vector<int> removedRows;
+        std::vector<juce::String> newCells;     // the cells of the added rows, a row after another
+        int numNewRows = 0;
+        std::vector<int> fileRows;              // the file row of every store row, the added ones last
+    };
+
+    /** Reads the table file on the background pool and compares it with the rows as they
+        were in the file when it was last read or written: a copy of the store taken when
+        the reload started, with the unsaved edits taken back out of it.
+    */
+    class ReloadJob  : public juce::ThreadPoolJob
+    {
+    public:
+        ReloadJob (PropertyWndComponent& owner, Reload request, const juce::File& fileToRead,
+                   TableRowStore storeToCompare, SelectionBits rowsToSkip)
+            : juce::ThreadPoolJob ("Table reload"),
+              safeOwner (&owner),
+              reload (std::move (request)),
+              file (fileToRead),
+              oldRows (std::move (storeToCompare)),
+              removedRows (std::move (rowsToSkip))
+        {}
+
+        JobStatus runJob() override
+        {
+            TableRowStore newRows;
+            reload.wasRead = newRows.loadFromFile (file, [this] { return shouldExit(); })
+                               && TableSnapshot::getSourceStamp (file) == reload.stamp;    // not written again while being read
+
+            if (shouldExit())
+                return jobHasFinished;
+
+            if (reload.wasRead)
+                findDifferences (oldRows, removedRows, newRows, reload);
+
+            juce::MessageManager::callAsync ([safeOwner = safeOwner, reload = std::move (reload)]() mutable
+            {
+                if (auto* owner = safeOwner.getComponent())
+                    owner->reloadRead (reload);
+            });
+
+            return jobHasFinished;
+        }
+
+    private:
+        juce::Component::SafePointer<PropertyWndComponent> safeOwner;
+        Reload reload;
+        const juce::File file;
+        TableRowStore oldRows;
+        SelectionBits removedRows;
+    };
+
+    /** Compares the rows of a table with a new version of it. Tables that can't be matched
+        up row by row, because their columns differ or their IDs are missing or repeated,
+        need loading from scratch instead. Select cells only differ if their flags do.
+    */
+    static void findDifferences (const TableRowStore& oldRows, const SelectionBits& rowsToSkip,
+                                 const TableRowStore& newRows, Reload& reload)
+    {
+        auto& schema = oldRows.getSchema();
+        auto storeIdSlot = schema.getSlotForName ("ID");
+        auto storeSelectSlot = schema.getSlotForName ("Select");
+
+        if (storeIdSlot < 0 || ! schema.hasSameColumns (newRows.getSchema()))
+        {
+            reload.needsFullLoad = true;
+            return;
+        }
+
+        std::unordered_map<juce::String, int> newRowsById;
+
+        for (int row = 0; row < newRows.getNumRows(); ++row)
+        {
+            if (! newRowsById.emplace (newRows.getCell (row, storeIdSlot), row).second)
+            {
+                reload.needsFullLoad = true;
+                return;
+            }
+        }
+
+        std::vector<bool> isMatched ((size_t) newRows.getNumRows());
+        reload.fileRows.assign ((size_t) oldRows.getNumRows(), -1);
+        juce::String newText, oldText;      // where getCellText() formats typed cells
+
+        for (int row = 0; row < oldRows.getNumRows(); ++row)
+        {
+            if (rowsToSkip[row])
+                continue;
+
+            auto found = newRowsById.find (oldRows.getCell (row, storeIdSlot));
+
+            if (found == newRowsById.end())
+            {
+                reload.removedRows.push_back (row);
+                continue;
+            }
+
+            auto newRow = found->second;
+
+            if (isMatched[(size_t) newRow])
+            {
+                reload.needsFullLoad = true;
+                return;
+            }
+
+            isMatched[(size_t) newRow] = true;
+            reload.fileRows[(size_t) row] = newRow;
+
+            for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+            {
+                if (slot == storeSelectSlot ? newRows.getBoolean (newRow, slot) != oldRows.getBoolean (row, slot)
+                                            : newRows.getCellText (newRow, slot, newText) != oldRows.getCellText (row, slot, oldText))
+                    reload.changes.push_back ({ row, schema.getColumn (slot).columnId, {}, newRows.getCell (newRow, slot) });
+            }
+        }
+
+        for (int newRow = 0; newRow < newRows.getNumRows(); ++newRow)
+        {
+            if (isMatched[(size_t) newRow])
+                continue;
+
+            for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+                reload.newCells.push_back (newRows.getCell (newRow, slot));
+
+            reload.fileRows.push_back (newRow);
+            ++reload.numNewRows;
+        }
+    }
+
+    /** Starts a reload if the table file isn't the version that the table was loaded
+        from or last wrote.
+    */
+    void tableFileMayHaveChanged (const TableSnapshot::FileInfo& stamp)
+    {
+        if (loadThread != nullptr || isReloading || stamp.size == 0 || stamp == failedReloadStamp
+             || stamp == (journal != nullptr ? journal->getTableStamp() : loadedStamp))     // a compaction rewrites the file too
+            return;
+
+        finishEditing (true);
+        writeSelectionFlagsToStore();
+
+        // the copy shares the store's cells, so only the ones put back here get copied
+        auto storeAsInFile = rowStore;
+
+        for (auto& [cell, fileText] : unsavedCells)
+            storeAsInFile.setCell (cell.first, getSlotForColumnId (cell.second), fileText);
+
+        if (selectSlot >= 0)
+            for (auto row : unsavedFlags)
+                storeAsInFile.setCell (row, selectSlot, selectionFlags[row] ? "0" : "1");
+
+        Reload request;
+        request.generation = ++reloadGeneration;
+        request.numUserEditsBefore = numUserEdits;
+        request.stamp = stamp;
+
+        isReloading = true;
+        backgroundPool.addJob (new ReloadJob (*this, std::move (request), loadedFile, std::move (storeAsInFile), removedRows), true);
+    }
+
+    /** Remembers the text in the file of a cell that's being changed by an edit, or forgets
+        it if the edit puts the text back.
+    */
+    void noteUnsavedEdit (int storeRow, int columnId, const juce::String& newText)
+    {
+        if (columnId == selectColumnId)
+        {
+            unsavedFlags.set (storeRow, ! unsavedFlags[storeRow]);
+            return;
+        }
+
+        auto [cell, isNew] = unsavedCells.try_emplace ({ storeRow, columnId }, juce::String());
+
+        if (isNew)
+            cell->second = rowStore.getCell (storeRow, getSlotForColumnId (columnId));
+
+        if (cell->second == newText)
+            unsavedCells.erase (cell);
+    }
+
+    /** Writes the unsaved edits that a reload has kept to the restarted journal. */
+    void journalUnsavedEdits()
+    {
+        if (unsavedCells.empty() && unsavedFlags.countSet() == 0)
+            return;
+
+        auto& newJournal = getJournal();
+        const auto idColumnId = idSlot >= 0 ? rowStore.getSchema().getColumn (idSlot).columnId : 0;
+
+        auto getIdInFile = [&] (int storeRow)
+        {
+            if (idSlot < 0)
+                return juce::String();
+
+            auto edited = unsavedCells.find ({ storeRow, idColumnId });
+            return edited != unsavedCells.end() ? edited->second : rowStore.getCell (storeRow, idSlot);
+        };
+
+        // edited IDs go last, as the other records find their rows by the IDs in the file
+        for (auto idsPass : { false, true })
+            for (auto& [cell, fileText] : unsavedCells)
+                if ((cell.second == idColumnId) == idsPass)
+                    newJournal.addCell (getFileRow (cell.first), cell.second, getIdInFile (cell.first),
+                                        rowStore.getCell (cell.first, getSlotForColumnId (cell.second)));
+
+        if (unsavedFlags.countSet() > 0)
+            newJournal.addFlippedFlags (getFlagsByFileRow (unsavedFlags));
+    }
+
+    /** Applies the differences a reload found. The rows that are still in the file keep
+        their store rows, so the sort, selection and scroll position stay as they were,
+        and only the rows that changed get repainted. The file wins over unsaved edits of
+        the cells that it has changed too, and of the rows it no longer has. The other
+        unsaved edits are kept, and go into the journal when it starts again.
+    */
+    void reloadRead (Reload& reload)
+    {
+        if (reload.generation != reloadGeneration)
+            return;
+
+        isReloading = false;
+
+        if (! reload.wasRead)
+        {
+            failedReloadStamp = reload.stamp;   // tried again when the file changes again
+            return;
+        }
+
+        if (reload.numUserEditsBefore != numUserEdits)
+            return;     // edited since the copy was taken, so the watcher starts another reload
+
+        if (reload.needsFullLoad || (reload.numNewRows > 0 && rowStore.isServedFromSnapshot()))
+        {
+            loadData (loadedFile);
+            return;
+        }
+
+        undoManager.clearUndoHistory();     // the old edits would undo the file's changes
+        const juce::ScopedValueSetter<bool> applyingReload (isApplyingReload, true);
+
+        auto& viewport = *tlbObject.getViewport();
+        const auto rowHeight = juce::jmax (1, tlbObject.getRowHeight());
+        const auto firstVisibleRow = viewport.getViewPositionY() / rowHeight;
+        std::vector<int> visibleStoreRows;
+
+        for (int i = 0; i <= tlbObject.getNumRowsOnScreen(); ++i)
+            visibleStoreRows.push_back (viewOrder.getStoreRow (firstVisibleRow + i));
+
+        removedRows.resize (rowStore.getNumRows());
+
+        for (auto row : reload.removedRows)
+        {
+            removedRows.set (row, true);
+            selectionFlags.set (row, false);
+            unsavedFlags.set (row, false);
+            unsavedCells.erase (unsavedCells.lower_bound ({ row, std::numeric_limits<int>::min() }),
+                                unsavedCells.lower_bound ({ row + 1, std::numeric_limits<int>::min() }));
+        }
+
+        for (auto& change : reload.changes)
+        {
+            if (change.columnId == selectColumnId)
+                unsavedFlags.set (change.storeRow, false);
+            else
+                unsavedCells.erase ({ change.storeRow, change.columnId });
+        }
+
+        for (auto& change : reload.changes)
+        {
+            if (change.columnId == selectColumnId)
+            {
+                // the file's text is kept, and the flag follows it
+                rowStore.setCell (change.storeRow, selectSlot, change.after);
+                change.after = rowStore.getBoolean (change.storeRow, selectSlot) ? "1" : "0";
+            }
+        }
+
+        applyCellChanges (reload.changes, false);
+
+        if (reload.numNewRows > 0)
+        {
+            auto firstNewRow = rowStore.getNumRows();
+            rowStore.appendRows (std::move (reload.newCells), reload.numNewRows);
+            rowsAppended (firstNewRow);
+        }
+
+        fileRows = std::move (reload.fileRows);
+        loadedStamp = reload.stamp;
+
+        if (journal != nullptr)
+            journal->restart (reload.stamp);
+
+        journalUnsavedEdits();
+
+        if (! reload.removedRows.empty() || reload.numNewRows > 0)
+        {
+            updateViewFilter();
+
+            // keep the row that was at the top of the view there, and repaint the other
+            // visible rows only if a different row has moved into their place
+            if (auto newTopRow = viewOrder.getViewRow (visibleStoreRows.front()); newTopRow >= 0 && newTopRow != firstVisibleRow)
+            {
+                viewport.setViewPosition (viewport.getViewPositionX(),
+                                          viewport.getViewPositionY() + (newTopRow - firstVisibleRow) * rowHeight);
+            }
+            else
+            {
+                for (int i = 0; i < (int) visibleStoreRows.size(); ++i)
+                    if (viewOrder.getStoreRow (firstVisibleRow + i) != visibleStoreRows[(size_t) i])
+                        tlbObject.repaintRow (firstVisibleRow + i);
+            }
+        }
+    }
+
+    /** Brings everything that's indexed by store row up to date with rows that a reload
+        has appended to the store, and puts them into the sorted order that's showing.
+    */
+    void rowsAppended (int firstNewRow)
+    {
+        readSelectionFlags();
+        removedRows.resize (rowStore.getNumRows());
+
+        const auto numNewRows = rowStore.getNumRows() - firstNewRow;
+        const auto isBigChange = numNewRows > maxCellsToUpdateOneByOne;
+        std::vector<int> slotsToMeasure;
+
+        for (int slot = 0; slot < rowStore.getNumColumns(); ++slot)
+        {
+            auto& keys = sortKeys[(size_t) slot];
+
+            if (isBigChange || (slot != selectSlot && rowStore.hasSortKeys (slot)))
+            {
+                keys = nullptr;     // typed and encoded keys are quick to copy again
+            }
+            else if (keys != nullptr)
+            {
+                if (keys.use_count() > 1)
+                    keys = std::make_shared<SortKeyColumn> (*keys);    // still shared with a sort job
+
+                for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+                {
+                    if (slot == selectSlot)
+                        keys->append (getSelectionSortKey (row));
+                    else
+                        keys->append (rowStore.getCell (row, slot));
+                }
+            }
+
+            if (slot == selectSlot)
+                continue;
+
+            if (isBigChange)
+            {
+                columnWidths.columnChanged (slot);
+                slotsToMeasure.push_back (slot);
+            }
+            else
+            {
+                for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+                    columnWidths.cellChanged (slot, row, font.getStringWidth (rowStore.getCell (row, slot)));
+            }
+        }
+
+        for (size_t slot = 0; slot < columnIndexes.size(); ++slot)
+        {
+            ++columnIndexVersions[slot];    // an index being sorted doesn't have the new rows
+
+            if (auto& index = columnIndexes[slot])
+            {
+                if (isBigChange)
+                {
+                    index = nullptr;
+                    continue;
+                }
+
+                auto keys = getSortKeysNow ((int) slot);
+                auto idKeys = idSlot >= 0 ? getSortKeysNow (idSlot) : nullptr;
+                DataSorter sorter (keys.get(), idKeys.get());
+
+                for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+                    index->insertRow (row, [&sorter] (int a, int b) { return sorter.compareElements (a, b) < 0; });
+            }
+        }
+
+        if (! slotsToMeasure.empty())
+            measureColumns (slotsToMeasure);
+
+        if (isBigChange)
+        {
+            trigramIndex = nullptr;
+            startIndexing();
+        }
+        else
+        {
+            for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+            {
+                if (trigramIndex != nullptr)
+                    trigramIndex->addChangedRow (row);
+                else
+                    rowsEditedWhileIndexing.push_back (row);
+            }
+        }
+
+        addNewRowsToFilterAndQuery (firstNewRow);
+        sortCache.clear();
+
+        if (pendingSortColumnId != 0)
+        {
+            startSort (pendingSortColumnId, pendingSortForwards);
+        }
+        else if (auto sortedRows = viewOrder.getSortedRows())
+        {
+            auto sortColumnId = tlbObject.getHeader().getSortColumnId();
+
+            if (getSlotForColumnId (sortColumnId) < 0)
+            {
+                viewOrder.setLoadOrder (rowStore.getNumRows());
+            }
+            else if (isBigChange)
+            {
+                startSort (sortColumnId, ! viewOrder.isReversed());
+            }
+            else
+            {
+                auto keys = getSortKeysNow (getSlotForColumnId (sortColumnId));
+                auto idKeys = idSlot >= 0 ? getSortKeysNow (idSlot) : nullptr;
+                DataSorter sorter (keys.get(), idKeys.get());
+                auto newSortedRows = std::make_shared<std::vector<int>> (*sortedRows);
+
+                for (auto row = firstNewRow; row < rowStore.getNumRows(); ++row)
+                    newSortedRows->insert (std::lower_bound (newSortedRows->begin(), newSortedRows->end(), row,
+                                                             [&sorter] (int a, int b) { return sorter.compareElements (a, b) < 0; }),
+                                           row);
+
+                viewOrder.setSortedRows (std::move (newSortedRows), viewOrder.isReversed());
+            }
+        }
+        else
+        {
+            viewOrder.setLoadOrder (rowStore.getNumRows());
+        }
+    }
+
+//! [loadData]
+    /** Loads a table. If there's an up-to-date snapshot of it, that gets mapped and the
+        table appears at once. Otherwise it's loaded in the background: the header
+        appears as soon as the <HEADERS> section has been read, and the rows as they
+        arrive, so a big table can be scrolled while the rest of it is still loading.
+    */
+    void loadData (juce::File tableFile)
+    {
+        TABLE_PROFILE_SCOPE ("loadData");
+
+        if (tableFile == juce::File() || ! tableFile.exists())
+            return;
+
+        loadThread.reset();
+        cancelPendingUpdate();
+        cancelPendingSort();
+        finishEditing (false);
+        undoManager.clearUndoHistory();
+
+        if (journal != nullptr)
+            journal->close();   // a compaction that is still running mustn't replace the old file now
+
+        rowStore.clear();
+        idSlot = selectSlot = -1;
+        selectionFlags.resize (0);
+        ++indexGeneration;
+        trigramIndex = nullptr;
+        filterSlots.clear();
+        filterQuery.clear();
+        filteredRows = nullptr;
+        filterBox.setText ({}, false);
+        columnIndexes.clear();
+        columnIndexVersions.clear();
+        columnIndexesBeingBuilt.clear();
+        ++columnIndexGeneration;
+        queryConditions.clear();
+        queryRows = nullptr;
+        viewOrder.setFilter (nullptr);
+        viewOrder.setLoadOrder (0);
+        sortCache.clear();
+        sortKeys.clear();
+        ++columnWidthGeneration;
+        columnWidths.reset (0, font);
+        rowImages.clear();
+        tlbObject.getHeader().removeAllColumns();
+        tlbObject.updateContent();
+        loadedFile = tableFile;
+
+        unsavedCells.clear();
+        unsavedFlags.resize (0);
+        removedRows.resize (0);
+        fileRows.clear();
+        failedReloadStamp = {};
+        ++reloadGeneration;
+        isReloading = false;
+
+        loadedStamp = TableSnapshot::getSourceStamp (tableFile);     // before anything reads it
+        journalToReplay = TableJournal::readRecords (tableFile);
+        numJournalRecordsReplayed = 0;
+        isCompactingJournal = false;
+        journal = nullptr;
+
+        if (fileWatcher == nullptr)
+            fileWatcher = std::make_unique<TableFileWatcher> (*this);
+
+        if (auto snapshot = TableSnapshot::open (TableSnapshot::getFileFor (tableFile), tableFile))
+        {
+            rowStore.setSnapshot (std::move (snapshot));
+            schemaLoaded();
+            rowsLoaded();
+            loadFinished ({});
+            return;
+        }
+
+        loadThread = std::make_unique<TableLoadThread> (*this, tableFile);     // [3]
+        loadThread->startThread();
+    }
+//! [loadData]
+
+    void handleAsyncUpdate() override
+    {
+        if (loadThread == nullptr)
+            return;
+
+        auto progress = loadThread->takeProgress();
+
+        if (progress.schema != nullptr)
+        {
+            rowStore.setSchema (*progress.schema);
+            schemaLoaded();
+        }
+
+        if (! progress.batches.empty())
+        {
+            for (auto& [cells, numRows] : progress.batches)
+                rowStore.appendRows (std::move (cells), numRows);                  // [4]
+
+            rowsLoaded();
+        }
+
+        if (progress.finished)
+        {
+            loadThread.reset();
+            loadFinished (progress.error);
+        }
+    }
+
+    void schemaLoaded()
+    {
+        auto& schema = rowStore.getSchema();
+
+        idSlot     = schema.getSlotForName ("ID");
+        selectSlot = schema.getSlotForName ("Select");                  // [5]
+        sortKeys.resize ((size_t) schema.getNumColumns());
+        columnIndexes.resize ((size_t) schema.getNumColumns());
+        columnIndexVersions.resize ((size_t) schema.getNumColumns());
+        columnIndexesBeingBuilt.resize ((size_t) schema.getNumColumns());
+        columnWidths.reset (schema.getNumColumns(), font);
+
+        for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+            if (schema.getColumn (slot).isText())
+                filterSlots.push_back (slot);
+
+        for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+        {
+            auto& column = schema.getColumn(slot);
+            auto isSelectColumn = column.columnId == selectColumnId;                       // its header shows a tick box instead
+
+            tlbObject.getHeader().addColumn(isSelectColumn ? juce::String() : column.name.toString(),   // [2]
+                column.columnId,
+                column.width,
+                50,
+                400,
+                isSelectColumn ? juce::TableHeaderComponent::visible | juce::TableHeaderComponent::resizable | juce::TableHeaderComponent::draggable
+                               : juce::TableHeaderComponent::defaultFlags);
+        }
+        tlbObject.getHeader().setSortColumnId(1, true);                                    // [3]
+    }
+
+    void rowsLoaded()
+    {
+        auto firstNewRow = selectionFlags.size();   // there's a flag for every row loaded before
+        TABLE_PROFILE_COUNT ("rowsLoaded", rowStore.getNumRows() - firstNewRow);
+        readSelectionFlags();
+
+        addNewRowsToFilterAndQuery (firstNewRow);
+        viewOrder.setFilter (getRowsMatchingFilterAndQuery());
+
+        viewOrder.setLoadOrder (rowStore.getNumRows());
+        tlbObject.updateContent();
+
+        // rows read from the file are snapshotted by loadFinished(), so the journal has to
+        // wait until then to go into them
+        if (loadThread == nullptr || ! shouldWriteSnapshots)
+            replayJournal (false);
+    }
+
+    /** Adds the rows from firstNewRow onwards to the filtered rows and the query's rows,
+        if they match them.
+    */
+    void addNewRowsToFilterAndQuery (int firstNewRow)
+    {
+        auto addNewMatchingRows = [&] (TableViewOrder::RowList& rows, auto&& isMatch)
+        {
+            if (rows == nullptr)
+                return;
+
+            auto matchingRows = std::make_shared<std::vector<int>> (*rows);
+
+            for (auto storeRow = firstNewRow; storeRow < rowStore.getNumRows(); ++storeRow)
+                if (isMatch (storeRow))
+                    matchingRows->push_back (storeRow);
+
+            rows = std::move (matchingRows);
+        };
+
+        addNewMatchingRows (filteredRows, [this] (int storeRow) { return rowMatchesFilter (storeRow, filterQuery); });
+        addNewMatchingRows (queryRows, [this] (int storeRow) { return rowMeetsQuery (storeRow); });
+    }
+
+    void loadFinished (const juce::String& error)
+    {
+        if (error.isNotEmpty())
+        {
+            DBG ("Couldn't load the table: " << error);
+        }
+        else if (! rowStore.isServedFromSnapshot())
+        {
+            // the journal hasn't been replayed yet, so the store holds just what's in the file
+            if (shouldWriteSnapshots)
+                backgroundPool.addJob (new SnapshotJob (rowStore, loadedFile, loadedStamp), true);
+
+            for (auto& encoded : rowStore.encodeLowCardinalityColumns())
+                sortKeys[(size_t) encoded.slot] = nullptr;     // encoded columns sort by their own keys
+        }
+
+        replayJournal (true);
+        startIndexing();
+        tlbObject.getHeader().reSortTable();
+        measureAllColumns();
+    }
+
+    //==============================================================================
+    /** Measures the widest cell of some columns on the background pool, and hands the
+        widths back to the message thread for the ColumnWidthCache.
+    */
+    class ColumnWidthJob  : public juce::ThreadPoolJob
+    {
+    public:
+        struct Column
+        {
+            int slot, version;
+            std::vector<juce::String> cells;
+            ColumnWidthCache::Measurement measurement;
+        };
+
+        ColumnWidthJob (PropertyWndComponent& owner, int generationToReport, const juce::Font& fontToUse,
+                        std::vector<int> rowsToMeasure, std::vector<Column> columnsToMeasure)
+            : juce::ThreadPoolJob ("Column widths"),
+              safeOwner (&owner),
+              generation (generationToReport),
+              font (fontToUse),
+              rows (std::move (rowsToMeasure)),
+              columns (std::move (columnsToMeasure))
+        {}
+
+        JobStatus runJob() override
+        {
+            for (auto& column : columns)
+            {
+                column.measurement = ColumnWidthCache::measure (column.cells, rows, font, [this] { return shouldExit(); });
+                column.cells = {};
+            }
+
+            if (shouldExit())
+                return jobHasFinished;
+
+            juce::MessageManager::callAsync ([safeOwner = safeOwner, generation = generation, columns = std::move (columns)]
+            {
+                if (auto* owner = safeOwner.getComponent())
+                    owner->columnWidthsMeasured (generation, columns);
+            });
+
+            return jobHasFinished;
+        }
+
+    private:
+        juce::Component::SafePointer<PropertyWndComponent> safeOwner;
+        int generation;
+        juce::Font font;
+        std::vector<int> rows;
+        std::vector<Column> columns;
+    };
+
+    void measureAllColumns()
+    {
+        ++columnWidthGeneration;
+        columnWidths.reset (rowStore.getNumColumns(), font);
+
+        std::vector<int> slots;
+
+        for (int slot = 0; slot < rowStore.getNumColumns(); ++slot)
+            if (slot != selectSlot)
+                slots.push_back (slot);
+
+        measureColumns (slots);
+    }
+
+    void measureColumns (const std::vector<int>& slots)
+    {
+        auto rows = ColumnWidthCache::chooseRowsToMeasure (rowStore.getNumRows());
+        std::vector<ColumnWidthJob::Column> columns;
+
+        for (auto slot : slots)
+            columns.push_back ({ slot, columnWidths.getVersion (slot), getCellsToMeasure (slot, rows), {} });
+
+        if (! columns.empty())
+            backgroundPool.addJob (new ColumnWidthJob (*this, columnWidthGeneration, font, std::move (rows), std::move (columns)), true);
+    }
+
+    void columnWidthsMeasured (int generation, const std::vector<ColumnWidthJob::Column>& columns)
+    {
+        if (generation != columnWidthGeneration)
+            return;
+
+        std::vector<int> editedSlots;
+
+        for (auto& column : columns)
+            if (! columnWidths.setMeasurement (column.slot, column.version, column.measurement))
+                editedSlots.push_back (column.slot);
+
+        measureColumns (editedSlots);
+    }
+
+    std::vector<juce::String> getCellsToMeasure (int slot, const std::vector<int>& rows) const
+    {
+        std::vector<juce::String> cells;
+        cells.reserve (rows.size());
+
+        for (auto row : rows)
+            cells.emplace_back (rowStore.getCell (row, slot));
+
+        return cells;
+    }
+
+    //==============================================================================
+    /** The undo record of a transaction: each edited cell's text before and after. */
+    class CellEditAction  : public juce::UndoableAction
+    {
+    public:
+        CellEditAction (PropertyWndComponent& ownerToEdit, std::vector<CellChange> changesToMake)
+            : owner (ownerToEdit), changes (std::move (changesToMake))
+        {}
+
+        bool perform() override                 { owner.applyCellChanges (changes, false); return true; }
+        bool undo() override                    { owner.applyCellChanges (changes, true);  return true; }
+        int getSizeInUnits() override           { return (int) changes.size(); }
+
+    private:
+        PropertyWndComponent& owner;
+        std::vector<CellChange> changes;
+    };
+
+    void commitEdit (const juce::String& transactionName, std::vector<CellChange> changes)
+    {
+        finishEditing (true);   // an open editor's text goes in before this transaction
+        undoManager.beginNewTransaction (transactionName);
+        undoManager.perform (new CellEditAction (*this, std::move (changes)));
+    }
+
+    /** Writes the new text of some cells, or puts back their old text in the reverse
+        order, and then brings everything that depends on them up to date in one go.
+
+        Each column's sort keys, index and width are patched cell by cell after a small
+        edit, but dropped to be rebuilt after a big one. Either way a sort that is still
+        running was working on a snapshot without the edits, so it gets restarted.
+    */
+    void applyCellChanges (std::vector<CellChange>& changes, bool shouldUndo)
+    {
+        std::map<int, std::vector<int>> editedRowsByColumn;
+        std::set<int> columnsWithStaleSortKeys;      // where an edit changed other rows' keys too
+
+        auto writeCell = [&] (const CellChange& change, const juce::String& newText)
+        {
+            auto slot = getSlotForColumnId (change.columnId);
+
+            if (change.columnId == selectColumnId ? selectionFlags[change.storeRow] == (newText.getIntValue() != 0)
+                                                  : rowStore.getCell (change.storeRow, slot) == newText)
+                return;
+
+            if (! isApplyingReload)
+                noteUnsavedEdit (change.storeRow, change.columnId, newText);
+
+            if (isUserEdit())
+            {
+                ++numUserEdits;
+
+                getJournal().addCell (getFileRow (change.storeRow), change.columnId,
+                                      idSlot >= 0 ? rowStore.getCell (change.storeRow, idSlot) : juce::String(), newText);
+            }
+
+            if (change.columnId == selectColumnId)
+                selectionFlags.set (change.storeRow, newText.getIntValue() != 0);
+            else if (rowStore.setCell (change.storeRow, slot, newText))
+                columnsWithStaleSortKeys.insert (change.columnId);
+
+            editedRowsByColumn[change.columnId].push_back (change.storeRow);
+        };
+
+        if (shouldUndo)
+        {
+            for (auto change = changes.rbegin(); change != changes.rend(); ++change)
+                writeCell (*change, change->before);
+        }
+        else
+        {
+            for (auto& change : changes)
+            {
+                change.before = change.columnId == selectColumnId ? juce::String (selectionFlags[change.storeRow] ? 1 : 0)
+                                                                  : rowStore.getCell (change.storeRow, getSlotForColumnId (change.columnId));
+                writeCell (change, change.after);
+            }
+        }
+
+        if (editedRowsByColumn.empty())
+            return;
+
+        compactJournalIfNeeded();
+
+        std::vector<int> editedRows, slotsToMeasure;
+        auto filterIndexIsStale = false;
+
+        for (auto& [columnId, rows] : editedRowsByColumn)
+        {
+            auto slot = columnId == selectColumnId ? selectSlot : getSlotForColumnId (columnId);
+            auto isBigEdit = (int) rows.size() > maxCellsToUpdateOneByOne;
+            editedRows.insert (editedRows.end(), rows.begin(), rows.end());
+
+            if (slot < 0)
+                continue;   // a table without a Select column still has flags, but nothing depends on them
+
+            columnChangedForIndexes (slot);
+
+            if (isBigEdit || columnsWithStaleSortKeys.count (columnId) > 0)
+            {
+                sortKeys[(size_t) slot] = nullptr;
+
+                for (size_t i = 0; i < columnIndexes.size(); ++i)
+                    if ((int) i == slot || slot == idSlot)
+                        columnIndexes[i] = nullptr;
+            }
+            else
+            {
+                for (auto row : rows)
+                    updateSortKeyAndIndex (row, slot);
+            }
+
+            if (slot == idSlot)
+                sortCache.clear();
+            else
+                sortCache.invalidateColumn (columnId);
+
+            if (columnId == selectColumnId)
+                continue;
+
+            if (isBigEdit)
+            {
+                columnWidths.columnChanged (slot);
+                slotsToMeasure.push_back (slot);
+            }
+            else
+            {
+                for (auto row : rows)
+                    if (columnWidths.cellChanged (slot, row, font.getStringWidth (rowStore.getCell (row, slot)))
+                         && std::find (slotsToMeasure.begin(), slotsToMeasure.end(), slot) == slotsToMeasure.end())
+                        slotsToMeasure.push_back (slot);
+            }
+
+            if (std::find (filterSlots.begin(), filterSlots.end(), slot) != filterSlots.end())
+            {
+                if (isBigEdit)
+                    filterIndexIsStale = true;
+                else if (trigramIndex != nullptr)
+                    for (auto row : rows)
+                        trigramIndex->addChangedRow (row);
+                else
+                    rowsEditedWhileIndexing.insert (rowsEditedWhileIndexing.end(), rows.begin(), rows.end());
+            }
+        }
+
+        if (! slotsToMeasure.empty())
+            measureColumns (slotsToMeasure);
+
+        if (filterIndexIsStale && loadThread == nullptr)
+        {
+            trigramIndex = nullptr;     // the filter scans every row until the new index is ready
+            startIndexing();
+        }
+
+        std::sort (editedRows.begin(), editedRows.end());
+        editedRows.erase (std::unique (editedRows.begin(), editedRows.end()), editedRows.end());
+        refilterRows (editedRows);
+
+        for (auto row : editedRows)
+            rowImages.removeRow (row);
+
+        if ((int) editedRows.size() > tlbObject.getNumRowsOnScreen())
+        {
+            tlbObject.repaint();
+        }
+        else
+        {
+            for (auto row : editedRows)
+                tlbObject.repaintRow (viewOrder.getViewRow (row));
+
+            if (editedRowsByColumn.count (selectColumnId) > 0)
+                tlbObject.getHeader().repaint();    // whether all the visible rows are ticked may have changed
+        }
+
+        if (pendingSortColumnId != 0)
+            startSort (pendingSortColumnId, pendingSortForwards);
+    }
+
+    /** Patches an edited row's key in a column's sort keys, if it has any yet. */
+    void updateSortKey (int storeRow, int slot)
+    {
+        auto& keys = sortKeys[(size_t) slot];
+
+        if (keys == nullptr)
+            return;
+
+        if (keys.use_count() > 1)
+            keys = std::make_shared<SortKeyColumn> (*keys);    // still shared with a sort job
+
+        if (slot == selectSlot)
+            keys->update (storeRow, getSelectionSortKey (storeRow));
+        else if (rowStore.hasSortKeys (slot))
+            keys->update (storeRow, rowStore.getSortKey (storeRow, slot));
+        else
+            keys->update (storeRow, rowStore.getCell (storeRow, slot));
+    }
+
+    std::vector<int> getSelectedStoreRows() const
+    {
+        std::vector<int> storeRows;
+        auto selectedRows = tlbObject.getSelectedRows();
+
+        for (int i = 0; i < selectedRows.getNumRanges(); ++i)
+        {
+            auto range = selectedRows.getRange (i);
+
+            for (auto viewRow = range.getStart(); viewRow < range.getEnd(); ++viewRow)
+                storeRows.push_back (viewOrder.getStoreRow (viewRow));
+        }
+
+        return storeRows;
+    }
+
+    void setSelectedStoreRows (const std::vector<int>& storeRows)
+    {
+        std::vector<int> viewRows;
+        viewRows.reserve (storeRows.size());
+
+        for (auto storeRow : storeRows)
+            if (auto viewRow = viewOrder.getViewRow (storeRow); viewRow >= 0)
+                viewRows.push_back (viewRow);
+
+        std::sort (viewRows.begin(), viewRows.end());
+
+        juce::SparseSet<int> selectedRows;
+
+        for (size_t i = 0; i < viewRows.size();)
+        {
+            auto end = i + 1;
+
+            while (end < viewRows.size() && viewRows[end] == viewRows[end - 1] + 1)
+                ++end;
+
+            selectedRows.addRange ({ viewRows[i], viewRows[end - 1] + 1 });
+            i = end;
+        }
+
+        tlbObject.setSelectedRows (selectedRows, juce::dontSendNotification);
+    }
+
+//! [getSlotForColumnId]
+    int getSlotForColumnId (const int columnId) const noexcept
+    {
+        return rowStore.getSchema().getSlotForColumnId (columnId);
     }
-//! [getAttributeNameForColumnId]
+//! [getSlotForColumnId]
 
     juce::FileChooser fileChooser { "Browse for TableData.xml",
                                     juce::File::getSpecialLocation (juce::File::invokedExecutableFile) };
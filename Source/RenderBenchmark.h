@@ -0,0 +1,199 @@
+#pragma once
+#include <JuceHeader.h>
+#include "PropertyWindow.h"
+#include "DataPathBenchmark.h"
+//==============================================================================
+/**
+    Measures how long the table takes to paint while it scrolls, without a window:
+    a PropertyWndComponent is given a size, left to load its table, and then painted
+    into an Image with the software renderer once per frame, scrolling a few rows
+    between frames. Each frame's time covers the scroll, which is where the list
+    refreshes its row and cell components, and the paint.
+
+    The table scrolls down and back up again until it has drawn the number of frames
+    asked for, and the result reports the frame time percentiles and how many cells
+    each frame drew.
+
+    The component never goes on the desktop, so this needs no display, and it's told
+    not to write a snapshot, so nothing is left beside the table.
+
+    Run ValuePropertyWndBenchmarks with "--benchmark-render" to print the JSON, with
+    these options as well as the synthetic table ones that DataPathBenchmark takes:
+
+        --table <file>          paint an existing table instead of a synthetic one
+        --rows <n>              the size of the synthetic table (1000000)
+        --width <n>             the component's size (1200 x 800)
+        --height <n>
+        --frames <n>            the number of frames to paint (600)
+        --scroll-step <n>       the pixels scrolled between frames (three rows)
+        --row-images            turn on drawing rows from cached images
+        --trace <file>          write a Chrome trace of the frames, in builds with
+                                TABLE_PROFILING turned on
+*/
+class RenderBenchmark  : private juce::Timer
+{
+public:
+    RenderBenchmark (const juce::StringArray& arguments, std::function<void (const juce::var&)> onFinishedCallback)
+        : onFinished (std::move (onFinishedCallback)),
+          width (DataPathBenchmark::getOption (arguments, "--width", "1200").getIntValue()),
+          height (DataPathBenchmark::getOption (arguments, "--height", "800").getIntValue()),
+          numFrames (juce::jmax (1, DataPathBenchmark::getOption (arguments, "--frames", "600").getIntValue())),
+          scrollStep (DataPathBenchmark::getOption (arguments, "--scroll-step", "0").getIntValue()),
+          useRowImages (arguments.contains ("--row-images")),
+          traceFile (arguments.contains ("--trace") ? juce::File::getCurrentWorkingDirectory().getChildFile (DataPathBenchmark::getOption (arguments, "--trace", {}))
+                                                    : juce::File())
+    {
+        auto tableFile = juce::File::getCurrentWorkingDirectory().getChildFile (DataPathBenchmark::getOption (arguments, "--table", {}));
+
+        if (! arguments.contains ("--table"))
+        {
+            auto options = DataPathBenchmark::getTableOptions (arguments);
+            options.numRows = DataPathBenchmark::getOption (arguments, "--rows", "1000000").getIntValue();
+
+            syntheticTable = std::make_unique<juce::TemporaryFile> (".xml");
+            tableFile = syntheticTable->getFile();
+
+            if (! SyntheticTable::write (tableFile, options))
+            {
+                finishWithError ("couldn't write the table");
+                return;
+            }
+        }
+
+        startTime = juce::Time::getMillisecondCounterHiRes();
+        component = std::make_unique<PropertyWndComponent> (tableFile);
+        component->setSnapshotWritingEnabled (false);
+        component->setSize (width, height);
+        component->setRowImageCachingEnabled (useRowImages);
+
+        startTimer (20);
+    }
+
+private:
+    std::function<void (const juce::var&)> onFinished;
+    const int width, height, numFrames;
+    int scrollStep;
+    const bool useRowImages;
+    const juce::File traceFile;
+
+    std::unique_ptr<juce::TemporaryFile> syntheticTable;
+    std::unique_ptr<PropertyWndComponent> component;
+    double startTime = 0.0;
+    int numIdlePolls = 0;
+
+    void timerCallback() override
+    {
+        if (component->isBusy())
+        {
+            numIdlePolls = 0;
+            return;
+        }
+
+        // one more poll, so that the results the background jobs posted get delivered
+        if (++numIdlePolls < 2)
+            return;
+
+        stopTimer();
+        onFinished (paintFrames (juce::Time::getMillisecondCounterHiRes() - startTime));
+    }
+
+    juce::var paintFrames (double readyMilliseconds)
+    {
+        auto& table = component->getTableListBox();
+        auto& viewport = *table.getViewport();
+        const auto rowHeight = table.getRowHeight();
+        const auto maxY = juce::jmax (0, component->getNumRows() * rowHeight - viewport.getViewHeight());
+
+        if (scrollStep <= 0)
+            scrollStep = rowHeight * 3;
+
+        juce::Image image (juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+        std::vector<double> frameMilliseconds;
+        std::vector<double> cellsDrawn, rowsFromImages;
+        int y = 0, direction = 1;
+
+       #if TABLE_PROFILING
+        auto& profiler = HotPathProfiler::getInstance();
+        profiler.setRecordingTrace (traceFile != juce::File());
+       #endif
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            component->resetPaintCounts();
+            const auto frameStartTime = juce::Time::getMillisecondCounterHiRes();
+
+            viewport.setViewPosition (0, y);
+
+            {
+                juce::Graphics g (image);
+                component->paintEntireComponent (g, true);
+            }
+
+            frameMilliseconds.push_back (juce::Time::getMillisecondCounterHiRes() - frameStartTime);
+            cellsDrawn.push_back (component->getPaintCounts().numCellsDrawn);
+            rowsFromImages.push_back (component->getPaintCounts().numRowsFromImages);
+
+            // bounce off the ends, so that any number of frames keeps scrolling
+            y += direction * scrollStep;
+
+            if (y < 0 || y > maxY)
+            {
+                direction = -direction;
+                y = juce::jlimit (0, maxY, y);
+            }
+        }
+
+        auto* result = new juce::DynamicObject();
+
+       #if TABLE_PROFILING
+        if (profiler.isRecordingTrace())
+        {
+            profiler.setRecordingTrace (false);
+            result->setProperty ("trace", profiler.writeChromeTrace (traceFile) ? traceFile.getFullPathName() : juce::String());
+        }
+       #endif
+
+        result->setProperty ("benchmark", "render");
+        result->setProperty ("version", ProjectInfo::versionString);
+        result->setProperty ("rows", component->getNumRows());
+        result->setProperty ("width", width);
+        result->setProperty ("height", height);
+        result->setProperty ("frames", numFrames);
+        result->setProperty ("scrollStep", scrollStep);
+        result->setProperty ("rowImages", useRowImages);
+        result->setProperty ("readyMilliseconds", readyMilliseconds);
+        result->setProperty ("frameMilliseconds", summarise (frameMilliseconds));
+        result->setProperty ("cellsDrawnPerFrame", summarise (cellsDrawn));
+        result->setProperty ("rowsFromImagesPerFrame", summarise (rowsFromImages));
+        return result;
+    }
+
+    void finishWithError (const juce::String& error)
+    {
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("error", error);
+
+        // called after the constructor has returned, so the callback can delete this
+        juce::MessageManager::callAsync ([onFinished = onFinished, result = juce::var (result)] { onFinished (result); });
+    }
+
+    static juce::var summarise (std::vector<double> values)
+    {
+        std::sort (values.begin(), values.end());
+
+        auto getPercentile = [&values] (double fraction)
+        {
+            return values[juce::jmin (values.size() - 1, (size_t) (fraction * (double) values.size()))];
+        };
+
+        auto* summary = new juce::DynamicObject();
+        summary->setProperty ("mean", std::accumulate (values.begin(), values.end(), 0.0) / (double) values.size());
+        summary->setProperty ("p50", getPercentile (0.5));
+        summary->setProperty ("p90", getPercentile (0.9));
+        summary->setProperty ("p99", getPercentile (0.99));
+        summary->setProperty ("max", values.back());
+        return summary;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderBenchmark)
+};
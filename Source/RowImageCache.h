@@ -0,0 +1,133 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    Keeps rendered table rows as images, so that scrolling can mostly blit rows that
+    have been painted before.
+
+    A strip is keyed by the store row it shows and everything else its pixels depend
+    on: selection, odd/even shading, size and display scale. Anything that changes
+    the way every row looks (the column layout, the font, the look-and-feel) has to
+    clear() the cache, and editing a row has to removeRow() it. Sorting needs
+    neither, because strips belong to store rows rather than to positions.
+
+    The least recently drawn strips are dropped to stay within the memory budget.
+*/
+class RowImageCache
+{
+public:
+    struct Key
+    {
+        int storeRow;
+        bool isSelected, isOddRow;
+        int width, height;
+        float scale;
+
+        bool operator== (const Key& other) const noexcept
+        {
+            return storeRow == other.storeRow && isSelected == other.isSelected && isOddRow == other.isOddRow
+                && width == other.width && height == other.height && scale == other.scale;
+        }
+    };
+
+    explicit RowImageCache (size_t maxBytesToUse = 64 * 1024 * 1024)
+        : maxBytes (maxBytesToUse)
+    {}
+
+    void setMaxBytes (size_t newMaxBytes)
+    {
+        maxBytes = newMaxBytes;
+        removeOldestUntilWithinBudget();
+    }
+
+    size_t getBytesUsed() const noexcept    { return bytesUsed; }
+
+    /** Returns the cached strip for a key, or a null image. */
+    juce::Image find (const Key& key)
+    {
+        auto range = stripsByRow.equal_range (key.storeRow);
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second->key == key)
+            {
+                strips.splice (strips.begin(), strips, it->second);
+                return it->second->image;
+            }
+        }
+
+        return {};
+    }
+
+    void add (const Key& key, const juce::Image& image)
+    {
+        strips.push_front ({ key, image, getSizeInBytes (image) });
+        stripsByRow.emplace (key.storeRow, strips.begin());
+        bytesUsed += strips.front().numBytes;
+
+        removeOldestUntilWithinBudget();
+    }
+
+    /** Drops every strip of a store row, e.g. because one of its cells was edited. */
+    void removeRow (int storeRow)
+    {
+        auto range = stripsByRow.equal_range (storeRow);
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            bytesUsed -= it->second->numBytes;
+            strips.erase (it->second);
+        }
+
+        stripsByRow.erase (range.first, range.second);
+    }
+
+    void clear()
+    {
+        strips.clear();
+        stripsByRow.clear();
+        bytesUsed = 0;
+    }
+
+private:
+    struct Strip
+    {
+        Key key;
+        juce::Image image;
+        size_t numBytes;
+    };
+
+    using StripList = std::list<Strip>;
+
+    size_t maxBytes, bytesUsed = 0;
+    StripList strips;       // most recently drawn first
+    std::unordered_multimap<int, StripList::iterator> stripsByRow;
+
+    static size_t getSizeInBytes (const juce::Image& image)
+    {
+        return (size_t) image.getWidth() * (size_t) image.getHeight() * 4;
+    }
+
+    void removeOldestUntilWithinBudget()
+    {
+        while (bytesUsed > maxBytes && ! strips.empty())
+        {
+            auto oldest = std::prev (strips.end());
+            auto range = stripsByRow.equal_range (oldest->key.storeRow);
+
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == oldest)
+                {
+                    stripsByRow.erase (it);
+                    break;
+                }
+            }
+
+            bytesUsed -= oldest->numBytes;
+            strips.erase (oldest);
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RowImageCache)
+};
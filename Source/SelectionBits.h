@@ -0,0 +1,172 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    One flag per row, packed 64 to a word, for the Select column.
+
+    The bulk operations work a word at a time, in loops simple enough for the compiler
+    to vectorise, so selecting, inverting or counting a million rows only touches
+    16K words. Bits past size() are always kept clear, so whole words can be counted
+    and inverted without masking every one of them.
+
+    Iterating over a SelectionBits gives the indexes of the bits that are set, in
+    ascending order.
+*/
+class SelectionBits
+{
+public:
+    int size() const noexcept   { return numBits; }
+
+    /** Changes the number of flags. Any new ones start out clear. */
+    void resize (int newNumBits)
+    {
+        jassert (newNumBits >= 0);
+
+        numBits = newNumBits;
+        words.resize (getNumWordsFor (newNumBits), 0);
+        clearUnusedBits();
+    }
+
+    bool operator[] (int index) const noexcept
+    {
+        return juce::isPositiveAndBelow (index, numBits)
+                && ((words[(size_t) index / bitsPerWord] >> ((size_t) index % bitsPerWord)) & 1) != 0;
+    }
+
+    void set (int index, bool shouldBeSet) noexcept
+    {
+        if (! juce::isPositiveAndBelow (index, numBits))
+            return;
+
+        const auto mask = (juce::uint64) 1 << ((size_t) index % bitsPerWord);
+        auto& word = words[(size_t) index / bitsPerWord];
+        word = shouldBeSet ? (word | mask) : (word & ~mask);
+    }
+
+    void setAll (bool shouldBeSet) noexcept
+    {
+        std::fill (words.begin(), words.end(), shouldBeSet ? ~(juce::uint64) 0 : 0);
+        clearUnusedBits();
+    }
+
+    /** Sets or clears the flags in a range, whole words at a time where it can. */
+    void setRange (juce::Range<int> range, bool shouldBeSet) noexcept
+    {
+        range = range.getIntersectionWith ({ 0, numBits });
+
+        auto index = range.getStart();
+
+        for (; index < range.getEnd() && (index % (int) bitsPerWord) != 0; ++index)
+            set (index, shouldBeSet);
+
+        for (; index + (int) bitsPerWord <= range.getEnd(); index += (int) bitsPerWord)
+            words[(size_t) index / bitsPerWord] = shouldBeSet ? ~(juce::uint64) 0 : 0;
+
+        for (; index < range.getEnd(); ++index)
+            set (index, shouldBeSet);
+    }
+
+    void invertAll() noexcept
+    {
+        for (auto& word : words)
+            word = ~word;
+
+        clearUnusedBits();
+    }
+
+    /** Flips the flags that are set in another SelectionBits. Any of its flags past
+        size() are ignored.
+    */
+    SelectionBits& operator^= (const SelectionBits& other) noexcept
+    {
+        auto numWords = juce::jmin (words.size(), other.words.size());
+
+        for (size_t i = 0; i < numWords; ++i)
+            words[i] ^= other.words[i];
+
+        clearUnusedBits();
+        return *this;
+    }
+
+    int countSet() const noexcept
+    {
+        int total = 0;
+
+        for (auto word : words)
+            total += juce::countNumberOfBits (word);
+
+        return total;
+    }
+
+    bool areAllSet() const noexcept     { return countSet() == numBits; }
+
+    //==============================================================================
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = int;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const int*;
+        using reference         = int;
+
+        Iterator (const std::vector<juce::uint64>& wordsToScan, size_t startWord) noexcept
+            : words (&wordsToScan), wordIndex (startWord)
+        {
+            if (wordIndex < words->size())
+                remaining = (*words)[wordIndex];
+
+            skipEmptyWords();
+        }
+
+        int operator*() const noexcept
+        {
+            // the index of the lowest set bit is the number of bits below it
+            return (int) (wordIndex * bitsPerWord) + juce::countNumberOfBits ((remaining & (~remaining + 1)) - 1);
+        }
+
+        Iterator& operator++() noexcept
+        {
+            remaining &= remaining - 1;
+            skipEmptyWords();
+            return *this;
+        }
+
+        bool operator== (const Iterator& other) const noexcept  { return wordIndex == other.wordIndex && remaining == other.remaining; }
+        bool operator!= (const Iterator& other) const noexcept  { return ! operator== (other); }
+
+    private:
+        const std::vector<juce::uint64>* words;
+        size_t wordIndex;
+        juce::uint64 remaining = 0;
+
+        void skipEmptyWords() noexcept
+        {
+            while (remaining == 0 && wordIndex < words->size())
+                if (++wordIndex < words->size())
+                    remaining = (*words)[wordIndex];
+        }
+    };
+
+    Iterator begin() const noexcept     { return { words, 0 }; }
+    Iterator end() const noexcept       { return { words, words.size() }; }
+
+private:
+    static constexpr size_t bitsPerWord = 64;
+
+    std::vector<juce::uint64> words;
+    int numBits = 0;
+
+    static size_t getNumWordsFor (int numBitsNeeded) noexcept
+    {
+        return ((size_t) numBitsNeeded + bitsPerWord - 1) / bitsPerWord;
+    }
+
+    void clearUnusedBits() noexcept
+    {
+        if (auto numUsedInLastWord = (size_t) numBits % bitsPerWord; numUsedInLastWord != 0)
+            words.back() &= ((juce::uint64) 1 << numUsedInLastWord) - 1;
+    }
+
+    JUCE_LEAK_DETECTOR (SelectionBits)
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    The natural-order collation keys of every cell in one column.
+
+    Each cell is encoded once into a byte string whose memcmp() order follows
+    juce::String::compareNatural(), so sorting compares raw bytes instead of
+    re-parsing two strings for every comparison:
+
+    - whitespace is skipped
+    - a run of digits becomes its significant-digit count followed by the digits, so
+      runs compare by numeric value; among equal values the one with more leading
+      zeros sorts first
+    - other letters and digits are upper-cased and stored as UTF-8; punctuation gets a
+      0x01 byte in front of it so that it sorts before all of them
+
+    The first eight bytes of every key are also kept inline as a big-endian integer,
+    so most comparisons are settled without touching the byte heap.
+
+    compareNatural() compares zero-padded runs digit by digit rather than by value, so
+    the two orders can differ for runs of different widths that start with a zero
+    (e.g. "010" and "09"). Columns padded to a fixed width, like our IDs, sort the same.
+
+    Columns with a declared type are sorted by the integer sort keys of their values
+    instead (see TypedColumn), which are stored as the inline prefix with no bytes.
+*/
+class SortKeyColumn
+{
+public:
+    /** Encodes a snapshot of the cells of a column, indexed by store row. */
+    explicit SortKeyColumn (const std::vector<juce::String>& cells)
+    {
+        keys.reserve (cells.size());
+
+        for (auto& cell : cells)
+            keys.push_back (appendKey (cell));
+    }
+
+    /** Wraps the sort keys of a typed column, indexed by store row. */
+    explicit SortKeyColumn (const std::vector<juce::uint64>& typedKeys)
+    {
+        keys.reserve (typedKeys.size());
+
+        for (auto key : typedKeys)
+            keys.push_back ({ key, 0, 0 });
+    }
+
+    int getNumRows() const noexcept     { return (int) keys.size(); }
+
+    /** Compares the keys of two rows, returning a negative, zero or positive value like memcmp. */
+    int compare (int firstRow, int secondRow) const noexcept
+    {
+        auto& first  = keys[(size_t) firstRow];
+        auto& second = keys[(size_t) secondRow];
+
+        if (first.prefix != second.prefix)
+            return first.prefix < second.prefix ? -1 : 1;
+
+        auto commonLength = juce::jmin (first.length, second.length);
+
+        if (commonLength > prefixSize)
+            if (auto result = std::memcmp (bytes.data() + first.offset + prefixSize,
+                                           bytes.data() + second.offset + prefixSize,
+                                           commonLength - prefixSize))
+                return result;
+
+        return first.length < second.length ? -1 : (first.length > second.length ? 1 : 0);
+    }
+
+    /** Re-encodes the key of a single cell after it has been edited. */
+    void update (int row, const juce::String& newText)
+    {
+        if (! juce::isPositiveAndBelow (row, getNumRows()))
+            return;
+
+        unusedBytes += keys[(size_t) row].length;
+        keys[(size_t) row] = appendKey (newText);
+
+        if (unusedBytes > bytes.size() / 2)
+            compact();
+    }
+
+    /** Replaces the key of a single cell of a typed column after it has been edited. */
+    void update (int row, juce::uint64 newTypedKey)
+    {
+        if (juce::isPositiveAndBelow (row, getNumRows()))
+            keys[(size_t) row] = { newTypedKey, 0, 0 };
+    }
+
+    /** Adds the key of a row appended to the column. */
+    void append (const juce::String& text)
+    {
+        keys.push_back (appendKey (text));
+    }
+
+    /** Adds the key of a row appended to a typed column. */
+    void append (juce::uint64 typedKey)
+    {
+        keys.push_back ({ typedKey, 0, 0 });
+    }
+
+    /** Compares two keys made by encode() the same way compare() compares the keys of
+        two rows.
+    */
+    static int compareEncoded (const std::vector<char>& first, const std::vector<char>& second) noexcept
+    {
+        auto firstPrefix  = getPrefix (first.data(), first.size());
+        auto secondPrefix = getPrefix (second.data(), second.size());
+
+        if (firstPrefix != secondPrefix)
+            return firstPrefix < secondPrefix ? -1 : 1;
+
+        auto commonLength = juce::jmin (first.size(), second.size());
+
+        if (commonLength > prefixSize)
+            if (auto result = std::memcmp (first.data() + prefixSize, second.data() + prefixSize, commonLength - prefixSize))
+                return result;
+
+        return first.size() < second.size() ? -1 : (first.size() > second.size() ? 1 : 0);
+    }
+
+    /** Appends the collation key of some text to a byte string. */
+    static void encode (const juce::String& text, std::vector<char>& dest)
+    {
+        for (auto t = text.getCharPointer(); ! t.isEmpty();)
+        {
+            auto c = *t;
+
+            if (juce::CharacterFunctions::isWhitespace (c))
+            {
+                ++t;
+            }
+            else if (c >= '0' && c <= '9')
+            {
+                size_t leadingZeros = 0;
+
+                while (*t == '0')
+                {
+                    ++leadingZeros;
+                    ++t;
+                }
+
+                dest.push_back (digitRunMarker);
+                dest.push_back (0);
+                const auto lengthIndex = dest.size() - 1;
+
+                while (*t >= '0' && *t <= '9')
+                    dest.push_back ((char) t.getAndAdvance());
+
+                dest[lengthIndex] = (char) juce::jmin (dest.size() - lengthIndex - 1, (size_t) 255);
+                dest.push_back ((char) (255 - juce::jmin (leadingZeros, (size_t) 254)));
+            }
+            else
+            {
+                if (juce::CharacterFunctions::isLetterOrDigit (c))
+                {
+                    appendUTF8 (juce::CharacterFunctions::toUpperCase (c), dest);
+                }
+                else
+                {
+                    dest.push_back (punctuationMarker);
+                    appendUTF8 (c, dest);
+                }
+
+                ++t;
+            }
+        }
+    }
+
+private:
+    struct Key
+    {
+        juce::uint64 prefix;
+        size_t offset;
+        size_t length;
+    };
+
+    static constexpr size_t prefixSize = sizeof (juce::uint64);
+
+    static constexpr char punctuationMarker = 1;
+    static constexpr char digitRunMarker = '0';     // sorts digit runs before letters, as their characters would
+
+    std::vector<char> bytes;
+    std::vector<Key> keys;
+    size_t unusedBytes = 0;
+
+    Key appendKey (const juce::String& text)
+    {
+        auto offset = bytes.size();
+        encode (text, bytes);
+        auto length = bytes.size() - offset;
+
+        return { getPrefix (bytes.data() + offset, length), offset, length };
+    }
+
+    /** Returns the first bytes of a key as a big-endian integer, padded with zeros. */
+    static juce::uint64 getPrefix (const char* key, size_t length) noexcept
+    {
+        juce::uint64 prefix = 0;
+
+        for (size_t i = 0; i < prefixSize; ++i)
+            prefix = (prefix << 8) | (i < length ? (juce::uint8) key[i] : 0);
+
+        return prefix;
+    }
+
+    void compact()
+    {
+        std::vector<char> packed;
+        packed.reserve (bytes.size() - unusedBytes);
+
+        for (auto& key : keys)
+        {
+            auto offset = packed.size();
+            packed.insert (packed.end(), bytes.begin() + (std::ptrdiff_t) key.offset,
+                                         bytes.begin() + (std::ptrdiff_t) (key.offset + key.length));
+            key.offset = offset;
+        }
+
+        bytes = std::move (packed);
+        unusedBytes = 0;
+    }
+
+    static void appendUTF8 (juce::juce_wchar c, std::vector<char>& dest)
+    {
+        char buffer[8] = {};
+        juce::CharPointer_UTF8 (buffer).write (c);
+        dest.insert (dest.end(), buffer, buffer + juce::CharPointer_UTF8::getBytesRequiredFor (c));
+    }
+
+    JUCE_LEAK_DETECTOR (SortKeyColumn)
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    Writes made-up tables with the same columns as the app's TableData.xml, for
+    measuring how the data path copes with far more rows than the real file has.
+
+    The same options and seed always give the same file. Module is drawn from
+    numDistinctValues different values and License from at most a handful, so they
+    behave like the low-cardinality columns of a real table; Name and Description
+    are random text whose length is picked between minTextLength and maxTextLength.
+    The cells only use letters, digits and spaces, so nothing needs escaping.
+*/
+class SyntheticTable
+{
+public:
+    struct Options
+    {
+        int numRows = 100000;
+        int numDistinctValues = 1000;
+        int minTextLength = 8;
+        int maxTextLength = 64;
+        juce::int64 seed = 1;
+    };
+
+    /** Writes a table file, replacing any that's there already. */
+    static bool write (const juce::File& tableFile, const Options& options)
+    {
+        tableFile.deleteFile();
+        juce::FileOutputStream output (tableFile, 1 << 20);
+
+        if (! output.openedOk())
+            return false;
+
+        output << "<TABLE_DATA>\n"
+                  "    <HEADERS>\n"
+                  "        <COLUMN columnId=\"1\" name=\"ID\" width=\"50\"/>\n"
+                  "        <COLUMN columnId=\"2\" name=\"Module\" width=\"200\"/>\n"
+                  "        <COLUMN columnId=\"3\" name=\"Name\" width=\"200\"/>\n"
+                  "        <COLUMN columnId=\"4\" name=\"Version\" width=\"100\" type=\"version\"/>\n"
+                  "        <COLUMN columnId=\"5\" name=\"License\" width=\"100\"/>\n"
+                  "        <COLUMN columnId=\"6\" name=\"Groups\" width=\"50\" type=\"int\"/>\n"
+                  "        <COLUMN columnId=\"7\" name=\"Dependencies\" width=\"50\" type=\"int\"/>\n"
+                  "        <COLUMN columnId=\"8\" name=\"Description\" width=\"300\"/>\n"
+                  "        <COLUMN columnId=\"9\" name=\"Select\" width=\"50\" type=\"bool\"/>\n"
+                  "    </HEADERS>\n"
+                  "    <DATA>\n";
+
+        juce::Random random (options.seed);
+        const auto modules = makeValues (random, juce::jmax (1, options.numDistinctValues), options);
+        const auto licenses = makeValues (random, juce::jlimit (1, 8, options.numDistinctValues), options);
+        const auto idLength = juce::String (options.numRows).length();
+        std::string row;
+
+        for (int i = 0; i < options.numRows; ++i)
+        {
+            row = "        <ITEM ID=\"";
+            row += juce::String (i + 1).paddedLeft ('0', idLength).toStdString();
+            row += "\" Module=\"";
+            row += modules[(size_t) random.nextInt ((int) modules.size())];
+            row += "\" Name=\"";
+            appendText (random, options, row);
+            row += "\" Version=\"";
+            row += std::to_string (random.nextInt (10)) + "." + std::to_string (random.nextInt (20)) + "." + std::to_string (random.nextInt (50));
+            row += "\" License=\"";
+            row += licenses[(size_t) random.nextInt ((int) licenses.size())];
+            row += "\" Groups=\"";
+            row += std::to_string (random.nextInt (100));
+            row += "\" Dependencies=\"";
+            row += std::to_string (random.nextInt (20));
+            row += "\" Description=\"";
+            appendText (random, options, row);
+            row += "\" Select=\"";
+            row += random.nextInt (10) == 0 ? "1" : "0";
+            row += "\"/>\n";
+
+            if (! output.write (row.data(), row.size()))
+                return false;
+        }
+
+        output << "    </DATA>\n"
+                  "</TABLE_DATA>\n";
+
+        output.flush();
+        return output.getStatus().wasOk();
+    }
+
+private:
+    /** Makes numValues different values, each starting with its number so none repeat. */
+    static std::vector<std::string> makeValues (juce::Random& random, int numValues, const Options& options)
+    {
+        std::vector<std::string> values;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            std::string value = "v" + std::to_string (i) + " ";
+            appendText (random, options, value);
+            values.push_back (std::move (value));
+        }
+
+        return values;
+    }
+
+    /** Appends random words, minTextLength to maxTextLength characters in all. */
+    static void appendText (juce::Random& random, const Options& options, std::string& text)
+    {
+        static constexpr char letters[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+        const auto minLength = juce::jmax (1, options.minTextLength);
+        const auto length = minLength + random.nextInt (juce::jmax (1, options.maxTextLength - minLength + 1));
+
+        for (int i = 0; i < length; ++i)
+        {
+            // a space every few letters, but never at either end
+            if (i > 0 && i < length - 1 && random.nextInt (7) == 0)
+                text += ' ';
+            else
+                text += letters[random.nextInt ((int) sizeof (letters) - 1)];
+        }
+    }
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    The columns declared in the <HEADERS> section of a table, compiled once when the
+    table is loaded.
+
+    Each column gets a slot, which is its position in the store's row records. Looking
+    a slot up from a TableListBox column id is a single array access, so the painting
+    and sorting code never has to scan the header list or parse attribute strings.
+
+    A <COLUMN> can declare the type of its cells with a "type" attribute: "int",
+    "float", "bool", "version" or "string". Columns without one, or with a type that
+    isn't recognised, hold text.
+*/
+class TableColumnSchema
+{
+public:
+    enum class ColumnType
+    {
+        text,
+        integer,
+        decimal,
+        boolean,
+        version
+    };
+
+    struct Column
+    {
+        int columnId = 0;
+        juce::Identifier name;
+        int width = 0;
+        ColumnType type = ColumnType::text;
+
+        bool isText() const noexcept    { return type == ColumnType::text; }
+    };
+
+    /** Returns the type named by a "type" attribute, or text if it's not one we know. */
+    static ColumnType getTypeForName (juce::StringRef name)
+    {
+        for (auto type : { ColumnType::integer, ColumnType::decimal, ColumnType::boolean, ColumnType::version })
+            if (name == getTypeName (type))
+                return type;
+
+        return ColumnType::text;
+    }
+
+    static const char* getTypeName (ColumnType type) noexcept
+    {
+        switch (type)
+        {
+            case ColumnType::integer:   return "int";
+            case ColumnType::decimal:   return "float";
+            case ColumnType::boolean:   return "bool";
+            case ColumnType::version:   return "version";
+            case ColumnType::text:      break;
+        }
+
+        return "string";
+    }
+
+    //==============================================================================
+    void clear()
+    {
+        columns.clear();
+        slotsByColumnId.clear();
+    }
+
+    /** Replaces the schema with the <COLUMN> entries of a <HEADERS> element. */
+    void loadFromXml (const juce::XmlElement& headersXml)
+    {
+        clear();
+
+        for (auto* columnXml : headersXml.getChildWithTagNameIterator ("COLUMN"))
+        {
+            auto name = columnXml->getStringAttribute ("name");
+
+            if (name.isNotEmpty())
+                addColumn (columnXml->getIntAttribute ("columnId"), name, columnXml->getIntAttribute ("width"),
+                           getTypeForName (columnXml->getStringAttribute ("type")));
+        }
+    }
+
+    void writeToXml (juce::XmlElement& headersXml) const
+    {
+        for (auto& column : columns)
+        {
+            auto* columnXml = headersXml.createNewChildElement ("COLUMN");
+            columnXml->setAttribute ("columnId", column.columnId);
+            columnXml->setAttribute ("name", column.name.toString());
+            columnXml->setAttribute ("width", column.width);
+
+            if (! column.isText())
+                columnXml->setAttribute ("type", getTypeName (column.type));
+        }
+    }
+
+    void addColumn (int columnId, const juce::Identifier& name, int width, ColumnType type = ColumnType::text)
+    {
+        jassert (columnId > 0 && getSlotForColumnId (columnId) < 0);   // TableListBox column ids must be unique and non-zero
+
+        if (columnId <= 0)
+            return;
+
+        if ((size_t) columnId >= slotsByColumnId.size())
+            slotsByColumnId.resize ((size_t) columnId + 1, -1);
+
+        slotsByColumnId[(size_t) columnId] = (int) columns.size();
+        columns.push_back ({ columnId, name, width, type });
+    }
+
+    //==============================================================================
+    int getNumColumns() const noexcept                  { return (int) columns.size(); }
+    const Column& getColumn (int slot) const            { return columns[(size_t) slot]; }
+
+    /** Returns the slot of a column id, or -1 if the id isn't part of the schema. */
+    int getSlotForColumnId (int columnId) const noexcept
+    {
+        return juce::isPositiveAndBelow (columnId, (int) slotsByColumnId.size()) ? slotsByColumnId[(size_t) columnId]
+                                                                                 : -1;
+    }
+
+    /** Returns the slot of a named column, or -1. Identifiers compare by pointer, but this
+        still walks the columns, so resolve the slot once rather than on every call.
+    */
+    int getSlotForName (const juce::Identifier& name) const noexcept
+    {
+        for (size_t i = 0; i < columns.size(); ++i)
+            if (columns[i].name == name)
+                return (int) i;
+
+        return -1;
+    }
+
+    /** Returns true if another schema has the same columns, with the same ids, names and
+        types in the same slots. Their widths may differ.
+    */
+    bool hasSameColumns (const TableColumnSchema& other) const noexcept
+    {
+        return std::equal (columns.begin(), columns.end(), other.columns.begin(), other.columns.end(),
+                           [] (const Column& a, const Column& b)
+                           {
+                               return a.columnId == b.columnId && a.name == b.name && a.type == b.type;
+                           });
+    }
+
+private:
+    std::vector<Column> columns;
+    std::vector<int> slotsByColumnId;
+
+    JUCE_LEAK_DETECTOR (TableColumnSchema)
+};
@@ -0,0 +1,618 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableColumnSchema.h"
+#include "WorkerThreads.h"
+//==============================================================================
+/**
+    Reads a TableData.xml file as a stream, without building an XML DOM.
+
+    The reader only understands as much XML as the table format needs: elements,
+    attributes and the standard character entities. Text, comments, processing
+    instructions, CDATA and DOCTYPE declarations are skipped. It reports the
+    <HEADERS> section as soon as it has been read, and then the <DATA> rows in
+    batches, with each row's cells laid out in schema slot order. <HEADERS> has to
+    come before <DATA>, as it does in every file we write.
+
+    Only a small input buffer and the current batch are held in memory, so loading
+    a big file needs little more than the memory of the rows themselves.
+
+    A table that's already in memory (e.g. a memory-mapped file) can be read with
+    readInParallel() instead, which splits the <DATA> section between threads.
+*/
+class TableDataReader
+{
+public:
+    TableDataReader() = default;
+
+    /** Called once the <HEADERS> section has been read. */
+    std::function<void (const TableColumnSchema&)> onSchemaRead;
+
+    /** Called with each batch of rows: numRows * schema.getNumColumns() cells, row by row.
+        readInParallel() calls this from its worker threads, though never concurrently.
+    */
+    std::function<void (std::vector<juce::String>&& cells, int numRows)> onRowsRead;
+
+    /** Polled between rows; return true to abandon the read. */
+    std::function<bool()> shouldExit;
+
+    int rowsPerBatch = 4096;
+
+    //==============================================================================
+    /** Reads a whole table. Returns false if the input wasn't a valid table or the read
+        was abandoned; getLastError() then says why.
+    */
+    bool read (juce::InputStream& input)
+    {
+        start (input);
+        schema.clear();
+
+        const auto ok = parseDocument (false);
+
+        if (ok)
+            flushBatch();
+
+        source = nullptr;
+        return ok;
+    }
+
+    /** Reads a table file, memory-mapping big ones and parsing their rows on all the
+        worker threads, and streaming smaller ones in.
+    */
+    bool readFile (const juce::File& file, WorkerThreads& workers)
+    {
+        if (file.getSize() >= parallelReadThreshold)
+        {
+            juce::MemoryMappedFile mappedFile (file, juce::MemoryMappedFile::readOnly);
+
+            if (mappedFile.getData() == nullptr)
+                return fail ("Couldn't map " + file.getFullPathName());
+
+            return readInParallel (mappedFile.getData(), mappedFile.getSize(), workers, juce::SystemStats::getNumCpus());
+        }
+
+        juce::FileInputStream input (file);
+
+        if (! input.openedOk())
+            return fail (input.getStatus().getErrorMessage());
+
+        return read (input);
+    }
+
+    /** Reads a whole table that's held in memory, parsing its <DATA> section on up to
+        numThreads threads and giving exactly the same rows as read().
+
+        The section is cut into pieces that each start at an "<ITEM" tag, so it mustn't
+        contain comments or CDATA with that text in them. The batches of each piece are
+        reported in file order, as soon as it and all the pieces before it are done.
+    */
+    bool readInParallel (const void* data, size_t numBytes, WorkerThreads& workers, int numThreads)
+    {
+        auto* text = static_cast<const char*> (data);
+
+        juce::MemoryInputStream headerInput (data, numBytes, false);
+        start (headerInput);
+        schema.clear();
+
+        const auto headerOk = parseDocument (true);
+        source = nullptr;
+
+        if (! headerOk)
+            return false;
+
+        if (! dataSectionFound)
+            return true;
+
+        // the rows run from the end of the <DATA> tag to the last </DATA>
+        const auto dataStart = bytesBeforeBuffer + bufferStart;
+        const char closingTag[] = "</DATA";
+        auto dataEnd = (size_t) (std::find_end (text + dataStart, text + numBytes,
+                                                closingTag, closingTag + sizeof (closingTag) - 1) - text);
+
+        if (dataEnd == numBytes)
+            return fail ("Unexpected end of file");
+
+        // cut them into a few pieces per thread, so that the first rows are ready early
+        const auto numPieces = (size_t) juce::jlimit (1, juce::jmax (1, numThreads) * 4,
+                                                      (int) ((dataEnd - dataStart) / minBytesPerPiece));
+        std::vector<size_t> bounds { dataStart };
+
+        for (size_t i = 1; i < numPieces; ++i)
+            bounds.push_back (juce::jmax (bounds.back(), findNextItem (text, dataStart + (dataEnd - dataStart) * i / numPieces, dataEnd)));
+
+        bounds.push_back (dataEnd);
+
+        struct Piece
+        {
+            std::vector<std::pair<std::vector<juce::String>, int>> batches;   // cells and number of rows
+            bool done = false;
+        };
+
+        std::vector<Piece> pieces (numPieces);
+        std::atomic<size_t> nextPiece { 0 };
+        std::atomic<bool> failed { false };
+        size_t nextPieceToReport = 0;
+        juce::CriticalSection reportLock;
+
+        workers.runTasks (juce::jlimit (1, (int) numPieces, numThreads), [&] (int)
+        {
+            for (size_t i; ! failed && (i = nextPiece++) < numPieces;)
+            {
+                auto& piece = pieces[i];
+                TableDataReader pieceReader;
+                pieceReader.shouldExit = shouldExit;
+                pieceReader.onRowsRead = [&piece] (std::vector<juce::String>&& cells, int numRows)
+                {
+                    piece.batches.emplace_back (std::move (cells), numRows);
+                };
+
+                const auto ok = pieceReader.readRows (text + bounds[i], bounds[i + 1] - bounds[i], schema);
+
+                const juce::ScopedLock sl (reportLock);
+
+                if (! ok)
+                {
+                    failed = true;
+                    lastError = pieceReader.getLastError();
+                    return;
+                }
+
+                piece.done = true;
+
+                for (; nextPieceToReport < numPieces && pieces[nextPieceToReport].done; ++nextPieceToReport)
+                {
+                    auto& readyPiece = pieces[nextPieceToReport];
+
+                    if (onRowsRead != nullptr)
+                        for (auto& [cells, numRows] : readyPiece.batches)
+                            onRowsRead (std::move (cells), numRows);
+
+                    readyPiece.batches = {};
+                }
+            }
+        });
+
+        return ! failed;
+    }
+
+    const juce::String& getLastError() const noexcept    { return lastError; }
+
+private:
+    /** Reads the <ITEM> rows in a slice of a <DATA> section. */
+    bool readRows (const char* data, size_t numBytes, const TableColumnSchema& tableSchema)
+    {
+        juce::MemoryInputStream input (data, numBytes, false);
+        start (input);
+        schema = tableSchema;
+
+        auto ok = true;
+
+        while (ok && skipToNextTag())
+        {
+            Tag tag;
+
+            if (! readTag (tag))
+                ok = false;
+            else if (tag.kind != Tag::end && tag.name == "ITEM")
+                ok = addRow (tag);
+        }
+
+        if (ok)
+            flushBatch();
+
+        source = nullptr;
+        return ok;
+    }
+
+    static size_t findNextItem (const char* text, size_t position, size_t end)
+    {
+        const char itemTag[] = "<ITEM";
+        const auto tagLength = sizeof (itemTag) - 1;
+
+        for (;;)
+        {
+            position = (size_t) (std::search (text + position, text + end, itemTag, itemTag + tagLength) - text);
+
+            if (position + tagLength >= end)
+                return end;
+
+            auto next = text[position + tagLength];
+
+            if (isSpace (next) || next == '/' || next == '>')
+                return position;
+
+            position += tagLength;
+        }
+    }
+
+    struct Tag
+    {
+        enum Kind { start, end, emptyElement };
+
+        Kind kind = start;
+        juce::String name;
+        std::vector<std::pair<juce::String, juce::String>> attributes;
+    };
+
+    static constexpr size_t minBytesPerPiece = 1 << 20;
+    static constexpr juce::int64 parallelReadThreshold = 4 * 1024 * 1024;
+
+    juce::InputStream* source = nullptr;
+    std::vector<char> buffer = std::vector<char> (65536);
+    size_t bufferStart = 0, bufferEnd = 0, bytesBeforeBuffer = 0;
+    juce::String lastError;
+    bool dataSectionFound = false;
+
+    TableColumnSchema schema;
+    std::vector<juce::String> batch;
+    int numRowsInBatch = 0;
+
+    void start (juce::InputStream& input)
+    {
+        source = &input;
+        bufferStart = bufferEnd = bytesBeforeBuffer = 0;
+        lastError.clear();
+        batch.clear();
+        numRowsInBatch = 0;
+        dataSectionFound = false;
+    }
+
+    //==============================================================================
+    /** Parses the document structure, reading the rows as well unless stopAtRows is set,
+        in which case it returns just after the opening <DATA> tag.
+    */
+    bool parseDocument (bool stopAtRows)
+    {
+        int depth = 0;
+        bool inHeaders = false, inData = false, schemaRead = false;
+
+        while (skipToNextTag())
+        {
+            Tag tag;
+
+            if (! readTag (tag))
+                return false;
+
+            if (tag.kind == Tag::end)
+            {
+                if (depth == 2 && inHeaders)
+                {
+                    inHeaders = false;
+                    schemaRead = true;
+                    reportSchema();
+                }
+
+                inData = inData && depth != 2;
+                --depth;
+                continue;
+            }
+
+            const auto level = depth + 1;
+
+            if (level == 2 && tag.name == "HEADERS")
+            {
+                inHeaders = true;
+                schema.clear();
+            }
+            else if (level == 2 && tag.name == "DATA")
+            {
+                if (! schemaRead)
+                    return fail ("The <DATA> section comes before <HEADERS>");
+
+                inData = true;
+
+                if (stopAtRows && tag.kind == Tag::start)
+                {
+                    dataSectionFound = true;
+                    return true;
+                }
+            }
+            else if (level == 3 && inHeaders && tag.name == "COLUMN")
+            {
+                addColumn (tag);
+            }
+            else if (level == 3 && inData && tag.name == "ITEM")
+            {
+                if (! addRow (tag))
+                    return false;
+            }
+
+            if (tag.kind == Tag::start)
+            {
+                ++depth;
+            }
+            else if (level == 2 && inHeaders)
+            {
+                inHeaders = false;      // an empty <HEADERS/>
+                schemaRead = true;
+                reportSchema();
+            }
+        }
+
+        if (depth != 0)
+            return fail ("Unexpected end of file");
+
+        return schemaRead || fail ("No <HEADERS> section found");
+    }
+
+    void reportSchema()
+    {
+        if (onSchemaRead != nullptr)
+            onSchemaRead (schema);
+    }
+
+    void addColumn (const Tag& tag)
+    {
+        juce::String name;
+        int columnId = 0, width = 0;
+        auto type = TableColumnSchema::ColumnType::text;
+
+        for (auto& [attribute, value] : tag.attributes)
+        {
+            if (attribute == "name")            name = value;
+            else if (attribute == "columnId")   columnId = value.getIntValue();
+            else if (attribute == "width")      width = value.getIntValue();
+            else if (attribute == "type")       type = TableColumnSchema::getTypeForName (value);
+        }
+
+        if (name.isNotEmpty())
+            schema.addColumn (columnId, name, width, type);
+    }
+
+    bool addRow (Tag& tag)
+    {
+        if (shouldExit != nullptr && shouldExit())
+            return fail ("Cancelled");
+
+        const auto numColumns = schema.getNumColumns();
+        const auto rowStart = batch.size();
+        batch.resize (rowStart + (size_t) numColumns);
+
+        for (size_t i = 0; i < tag.attributes.size(); ++i)
+        {
+            auto& [attribute, value] = tag.attributes[i];
+
+            // rows nearly always list their attributes in schema order, so try that slot first
+            auto slot = juce::isPositiveAndBelow ((int) i, numColumns) && schema.getColumn ((int) i).name.toString() == attribute
+                          ? (int) i
+                          : schema.getSlotForName (attribute);
+
+            if (slot >= 0)
+                batch[rowStart + (size_t) slot] = std::move (value);
+        }
+
+        if (++numRowsInBatch >= rowsPerBatch)
+            flushBatch();
+
+        return true;
+    }
+
+    void flushBatch()
+    {
+        if (numRowsInBatch > 0 && onRowsRead != nullptr)
+            onRowsRead (std::move (batch), numRowsInBatch);
+
+        batch = {};
+        batch.reserve ((size_t) (rowsPerBatch * schema.getNumColumns()));
+        numRowsInBatch = 0;
+    }
+
+    bool fail (const juce::String& error)
+    {
+        lastError = error;
+        return false;
+    }
+
+    //==============================================================================
+    int peekChar()
+    {
+        if (bufferStart == bufferEnd)
+        {
+            bytesBeforeBuffer += bufferEnd;
+            bufferStart = 0;
+            bufferEnd = (size_t) juce::jmax (0, source->read (buffer.data(), (int) buffer.size()));
+
+            if (bufferEnd == 0)
+                return -1;
+        }
+
+        return (unsigned char) buffer[bufferStart];
+    }
+
+    int nextChar()
+    {
+        auto c = peekChar();
+
+        if (c >= 0)
+            ++bufferStart;
+
+        return c;
+    }
+
+    static bool isSpace (int c) noexcept     { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skipWhitespace()
+    {
+        while (isSpace (peekChar()))
+            ++bufferStart;
+    }
+
+    /** Skips to just after the next '<' that starts an element, returning false at the end of the input. */
+    bool skipToNextTag()
+    {
+        for (;;)
+        {
+            int c;
+
+            while ((c = nextChar()) >= 0 && c != '<')
+            {}
+
+            if (c < 0)
+                return false;
+
+            auto next = peekChar();
+
+            if (next == '?')
+            {
+                skipPast ("?>");
+            }
+            else if (next == '!')
+            {
+                ++bufferStart;
+
+                if (peekChar() == '-')
+                    skipPast ("-->");
+                else if (peekChar() == '[')
+                    skipPast ("]]>");
+                else
+                    skipPast (">");
+            }
+            else
+            {
+                return true;
+            }
+        }
+    }
+
+    void skipPast (const char* terminator)
+    {
+        const auto length = std::strlen (terminator);
+        size_t matched = 0;
+
+        for (int c; matched < length && (c = nextChar()) >= 0;)
+            matched = c == terminator[matched] ? matched + 1 : (c == terminator[0] ? 1 : 0);
+    }
+
+    void readName (std::string& dest)
+    {
+        dest.clear();
+
+        for (int c; (c = peekChar()) >= 0 && ! isSpace (c) && c != '>' && c != '/' && c != '=';)
+        {
+            dest.push_back ((char) c);
+            ++bufferStart;
+        }
+    }
+
+    /** Reads the rest of a tag whose '<' has just been consumed. */
+    bool readTag (Tag& tag)
+    {
+        std::string text;
+
+        if (peekChar() == '/')
+        {
+            ++bufferStart;
+            tag.kind = Tag::end;
+            readName (text);
+            tag.name = juce::String::fromUTF8 (text.data(), (int) text.size());
+            skipPast (">");
+            return true;
+        }
+
+        readName (text);
+        tag.name = juce::String::fromUTF8 (text.data(), (int) text.size());
+
+        if (tag.name.isEmpty())
+            return fail ("Malformed element");
+
+        for (;;)
+        {
+            skipWhitespace();
+            auto c = nextChar();
+
+            if (c == '>')
+                return true;
+
+            if (c == '/')
+            {
+                tag.kind = Tag::emptyElement;
+                skipPast (">");
+                return true;
+            }
+
+            if (c < 0)
+                return fail ("Unexpected end of file inside <" + tag.name + ">");
+
+            --bufferStart;
+            readName (text);
+            auto attribute = juce::String::fromUTF8 (text.data(), (int) text.size());
+
+            skipWhitespace();
+
+            if (nextChar() != '=')
+                return fail ("Expected '=' after attribute " + attribute);
+
+            skipWhitespace();
+            auto quote = nextChar();
+
+            if (quote != '"' && quote != '\'')
+                return fail ("Expected a quoted value for attribute " + attribute);
+
+            if (! readAttributeValue (quote, text))
+                return fail ("Unterminated value for attribute " + attribute);
+
+            tag.attributes.emplace_back (attribute, juce::String::fromUTF8 (text.data(), (int) text.size()));
+        }
+    }
+
+    bool readAttributeValue (int quote, std::string& dest)
+    {
+        dest.clear();
+
+        for (;;)
+        {
+            auto c = nextChar();
+
+            if (c < 0)
+                return false;
+
+            if (c == quote)
+                return true;
+
+            if (c == '&')
+                appendEntity (dest);
+            else
+                dest.push_back ((char) c);
+        }
+    }
+
+    void appendEntity (std::string& dest)
+    {
+        std::string entity;
+
+        for (int c; (c = peekChar()) >= 0 && c != ';' && entity.size() < 10;)
+        {
+            entity.push_back ((char) c);
+            ++bufferStart;
+        }
+
+        const auto terminated = peekChar() == ';';
+
+        if (terminated)
+            ++bufferStart;
+
+        if (entity == "amp")        { dest.push_back ('&');  return; }
+        if (entity == "lt")         { dest.push_back ('<');  return; }
+        if (entity == "gt")         { dest.push_back ('>');  return; }
+        if (entity == "quot")       { dest.push_back ('"');  return; }
+        if (entity == "apos")       { dest.push_back ('\''); return; }
+
+        if (entity.size() > 1 && entity[0] == '#')
+        {
+            auto isHex = entity[1] == 'x' || entity[1] == 'X';
+            auto value = (juce::juce_wchar) std::strtol (entity.c_str() + (isHex ? 2 : 1), nullptr, isHex ? 16 : 10);
+
+            char utf8[8] = {};
+            juce::CharPointer_UTF8 (utf8).write (value);
+            dest.append (utf8, juce::CharPointer_UTF8::getBytesRequiredFor (value));
+            return;
+        }
+
+        dest.push_back ('&');      // not an entity we know, so keep it as it was
+        dest += entity;
+
+        if (terminated)
+            dest.push_back (';');
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TableDataReader)
+};
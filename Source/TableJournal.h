@@ -0,0 +1,458 @@
+#pragma once
+#include <JuceHeader.h>
+#include <cstdio>
+#include "SelectionBits.h"
+#include "TableSnapshot.h"
+
+#if JUCE_WINDOWS
+ #include <io.h>
+#else
+ #include <unistd.h>
+#endif
+//==============================================================================
+/**
+    An append-only log of the edits made to a table since its file was last written,
+    kept beside it so that saving an edit costs a few bytes of I/O rather than the
+    whole file.
+
+    The journal starts with a header recording the size and modification time of the
+    table file it applies to, like a TableSnapshot's, so that a journal left behind by
+    an older version of the table is ignored. Every record after it is one edit:
+
+    - a cell: its store row, column ID, the row's ID and the cell's new text
+    - a set of Select flags that were flipped, as runs of store rows
+
+    Each record is prefixed with its size and a checksum, so a record that a crash
+    tore part-way through is spotted, and it and anything after it get dropped.
+
+    Records are queued by the message thread and written by a background thread, which
+    syncs the file to disk once for everything queued since it last woke, at most every
+    syncIntervalMs. Once the journal has grown big enough, a background job folds it
+    into a new table file with startCompaction() and finishCompaction().
+*/
+class TableJournal  : private juce::Thread
+{
+public:
+    /** Returns the file that the journal of a table file is kept in. */
+    static juce::File getFileFor (const juce::File& tableFile)
+    {
+        return tableFile.getSiblingFile (tableFile.getFileName() + ".journal");
+    }
+
+    /** One edit read back from a journal. */
+    struct Record
+    {
+        int storeRow = -1;
+        int columnId = 0;               // 0 for flipped Select flags
+        juce::String rowId, text;
+        SelectionBits flippedFlags;
+
+        bool isFlippedFlags() const noexcept    { return columnId == 0; }
+    };
+
+    /** Reads the edits in the journal of a table file, in the order they were made.
+        Returns nothing if there's no journal, or it belongs to another version of the table.
+    */
+    static std::vector<Record> readRecords (const juce::File& tableFile)
+    {
+        juce::MemoryBlock data;
+        return readJournal (getFileFor (tableFile), TableSnapshot::getSourceStamp (tableFile), data).records;
+    }
+
+    //==============================================================================
+    /** Opens the journal of a table file for adding edits to. tableStampToUse describes
+        the version of the file that the edits apply to, as it was when it was read. Edits
+        already in the journal are kept if they apply to that version too, and anything
+        else gets dropped.
+    */
+    TableJournal (const juce::File& tableFileToJournal, const TableSnapshot::FileInfo& tableStampToUse)
+        : juce::Thread ("Table journal"),
+          tableFile (tableFileToJournal),
+          journalFile (getFileFor (tableFileToJournal))
+    {
+        juce::MemoryBlock data;
+        auto stamp = tableStampToUse;
+        auto existing = readJournal (journalFile, stamp, data);
+
+        const juce::ScopedLock sl (fileLock);
+        tableStamp = stamp;
+
+        if (existing.records.empty() || existing.validSize != (juce::int64) data.getSize())
+            rewrite (stamp, data, headerSize, existing.validSize);
+        else
+            reopen();
+
+        startThread();
+    }
+
+    ~TableJournal() override
+    {
+        close();
+    }
+
+    /** Writes whatever is still queued and stops adding to the journal. */
+    void close()
+    {
+        stopThread (10000);
+        writeQueued();
+
+        const juce::ScopedLock sl (fileLock);
+        isClosed = true;
+
+        if (file != nullptr)
+            std::fclose (std::exchange (file, nullptr));
+    }
+
+    /** Queues an edit of a cell. rowId is the row's ID before the edit. */
+    void addCell (int storeRow, int columnId, const juce::String& rowId, const juce::String& newText)
+    {
+        juce::MemoryOutputStream payload;
+        payload.writeByte ((char) RecordType::cell);
+        payload.writeInt (storeRow);
+        payload.writeInt (columnId);
+        payload.writeString (rowId);
+        payload.writeString (newText);
+        queue (payload);
+    }
+
+    /** Queues a change to the Select flags, given as the flags that flipped. */
+    void addFlippedFlags (const SelectionBits& flippedFlags)
+    {
+        std::vector<juce::Range<int>> runs;
+
+        for (auto row : flippedFlags)
+        {
+            if (! runs.empty() && runs.back().getEnd() == row)
+                runs.back().setEnd (row + 1);
+            else
+                runs.push_back ({ row, row + 1 });
+        }
+
+        juce::MemoryOutputStream payload;
+        payload.writeByte ((char) RecordType::flippedFlags);
+        payload.writeInt (flippedFlags.size());
+        payload.writeInt ((int) runs.size());
+
+        for (auto run : runs)
+        {
+            payload.writeInt (run.getStart());
+            payload.writeInt (run.getLength());
+        }
+
+        queue (payload);
+    }
+
+    /** Returns the size of the journal, including the edits that are still queued. */
+    juce::int64 getSize() const noexcept        { return size.load(); }
+
+    //==============================================================================
+    /** The edits that a compaction folds into the table file, and where they end. */
+    struct Compaction
+    {
+        std::vector<Record> records;
+        juce::int64 endPosition = 0;
+        int generation = 0;
+    };
+
+    /** Writes out the queued edits and returns every edit in the journal, for a new
+        table file to be made from. Call from a background thread.
+    */
+    Compaction startCompaction()
+    {
+        writeQueued();
+
+        const juce::ScopedLock sl (fileLock);
+        juce::MemoryBlock data;
+        auto existing = readJournal (journalFile, tableStamp, data);
+
+        return { std::move (existing.records), existing.validSize, generation };
+    }
+
+    /** Replaces the table file with one that has the compaction's edits in it, and
+        starts the journal again with just the edits made since startCompaction(). Returns
+        false, leaving both files alone, if the journal was restarted or closed meanwhile,
+        or something else has written the table file.
+
+        The table file is replaced before the journal. A crash between the two leaves a
+        journal that no longer matches the table file, losing the edits made during the
+        compaction, but never applying edits twice.
+    */
+    bool finishCompaction (const juce::TemporaryFile& newTableFile, const Compaction& compaction)
+    {
+        writeQueued();
+
+        const juce::ScopedLock sl (fileLock);
+
+        if (isClosed || compaction.generation != generation || TableSnapshot::getSourceStamp (tableFile) != tableStamp)
+            return false;
+
+        juce::MemoryBlock data;
+        journalFile.loadFileAsData (data);
+
+        if (! newTableFile.overwriteTargetFileWithTemporary())
+            return false;
+
+        rewrite (TableSnapshot::getSourceStamp (tableFile), data, compaction.endPosition, (juce::int64) data.getSize());
+        return true;
+    }
+
+    /** Returns the size and modification time of the version of the table file that the
+        journal's edits apply to. If the file's own stamp differs, something else has
+        written it.
+    */
+    TableSnapshot::FileInfo getTableStamp() const
+    {
+        const juce::ScopedLock sl (fileLock);
+        return tableStamp;
+    }
+
+    /** Empties the journal, after the whole table has been written to its file or read
+        back from it. The stamp is that of the file as it was written or read.
+    */
+    void restart (const TableSnapshot::FileInfo& newTableStamp)
+    {
+        {
+            const juce::ScopedLock sl (queueLock);
+            queuedBytes.clear();
+        }
+
+        const juce::ScopedLock sl (fileLock);
+
+        if (! isClosed)
+            rewrite (newTableStamp, {}, 0, 0);
+    }
+
+private:
+    enum class RecordType : juce::uint8
+    {
+        cell = 1,
+        flippedFlags = 2
+    };
+
+    static constexpr int magicNumber = 0x4c4e4a54;     // "TJNL"
+    static constexpr int formatVersion = 1;
+    static constexpr juce::int64 headerSize = 24;
+    static constexpr int syncIntervalMs = 50;
+
+    const juce::File tableFile, journalFile;
+
+    juce::CriticalSection queueLock;
+    std::vector<char> queuedBytes;
+    std::atomic<juce::int64> size { 0 };
+
+    juce::CriticalSection fileLock;     // held while the file is written, synced or replaced
+    std::FILE* file = nullptr;
+    TableSnapshot::FileInfo tableStamp;
+    int generation = 0;
+    bool isClosed = false;
+
+    //==============================================================================
+    struct Contents
+    {
+        std::vector<Record> records;
+        juce::int64 validSize = 0;
+    };
+
+    /** Reads the valid records of a journal into data, stopping at the first one that's
+        torn or damaged.
+    */
+    static Contents readJournal (const juce::File& journal, const TableSnapshot::FileInfo& tableStamp, juce::MemoryBlock& data)
+    {
+        Contents contents;
+
+        if (! journal.existsAsFile() || ! journal.loadFileAsData (data) || (juce::int64) data.getSize() < headerSize)
+            return contents;
+
+        juce::MemoryInputStream in (data, false);
+
+        if (in.readInt() != magicNumber || in.readInt() != formatVersion
+             || in.readInt64() != tableStamp.size || in.readInt64() != tableStamp.modificationTime)
+            return contents;
+
+        contents.validSize = headerSize;
+
+        for (;;)
+        {
+            auto recordStart = in.getPosition();
+
+            if (in.getNumBytesRemaining() < 8)
+                break;
+
+            auto payloadSize = in.readInt();
+            auto checksum = (juce::uint32) in.readInt();
+
+            if (payloadSize <= 0 || payloadSize > in.getNumBytesRemaining())
+                break;
+
+            auto* payload = static_cast<const char*> (data.getData()) + recordStart + 8;
+
+            if (getChecksum (payload, (size_t) payloadSize) != checksum)
+                break;
+
+            juce::MemoryInputStream payloadIn (payload, (size_t) payloadSize, false);
+            Record record;
+
+            if (! readPayload (payloadIn, record))
+                break;
+
+            contents.records.push_back (std::move (record));
+            in.skipNextBytes (payloadSize);
+            contents.validSize = in.getPosition();
+        }
+
+        return contents;
+    }
+
+    static bool readPayload (juce::MemoryInputStream& in, Record& record)
+    {
+        auto type = (RecordType) in.readByte();
+
+        if (type == RecordType::cell)
+        {
+            record.storeRow = in.readInt();
+            record.columnId = in.readInt();
+            record.rowId = in.readString();
+            record.text = in.readString();
+            return record.columnId != 0;
+        }
+
+        if (type == RecordType::flippedFlags)
+        {
+            record.flippedFlags.resize (juce::jmax (0, in.readInt()));
+
+            for (auto numRuns = in.readInt(); numRuns > 0 && ! in.isExhausted(); --numRuns)
+            {
+                auto start = in.readInt();
+                record.flippedFlags.setRange ({ start, start + in.readInt() }, true);
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    /** FNV-1a, which is plenty for spotting a torn write. */
+    static juce::uint32 getChecksum (const char* data, size_t numBytes) noexcept
+    {
+        juce::uint32 hash = 2166136261u;
+
+        for (size_t i = 0; i < numBytes; ++i)
+            hash = (hash ^ (juce::uint8) data[i]) * 16777619u;
+
+        return hash;
+    }
+
+    //==============================================================================
+    void queue (const juce::MemoryOutputStream& payload)
+    {
+        auto* payloadData = static_cast<const char*> (payload.getData());
+        auto payloadSize = payload.getDataSize();
+
+        juce::MemoryOutputStream record (payloadSize + 8);
+        record.writeInt ((int) payloadSize);
+        record.writeInt ((int) getChecksum (payloadData, payloadSize));
+        record.write (payloadData, payloadSize);
+
+        {
+            const juce::ScopedLock sl (queueLock);
+            auto* recordData = static_cast<const char*> (record.getData());
+            queuedBytes.insert (queuedBytes.end(), recordData, recordData + record.getDataSize());
+        }
+
+        size += (juce::int64) record.getDataSize();
+        notify();
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait (-1);
+            writeQueued();
+
+            // everything queued while this sleeps gets synced together
+            juce::Thread::sleep (syncIntervalMs);
+        }
+    }
+
+    void writeQueued()
+    {
+        std::vector<char> bytes;
+
+        {
+            const juce::ScopedLock sl (queueLock);
+            bytes.swap (queuedBytes);
+        }
+
+        if (bytes.empty())
+            return;
+
+        const juce::ScopedLock sl (fileLock);
+
+        if (file == nullptr
+             || std::fwrite (bytes.data(), 1, bytes.size(), file) != bytes.size()
+             || std::fflush (file) != 0
+             || ! syncToDisk (file))
+            DBG ("Couldn't write to " << journalFile.getFullPathName());
+    }
+
+    /** Replaces the journal with a header for the given table stamp, followed by a range
+        of the bytes of an old journal. Must be called with fileLock held.
+    */
+    void rewrite (const TableSnapshot::FileInfo& newTableStamp, const juce::MemoryBlock& oldJournal,
+                  juce::int64 startOfRecordsToKeep, juce::int64 endOfRecordsToKeep)
+    {
+        if (file != nullptr)
+            std::fclose (std::exchange (file, nullptr));    // a file that's open can't be replaced on Windows
+
+        ++generation;
+
+        juce::TemporaryFile tempFile (journalFile);
+
+        {
+            juce::FileOutputStream out (tempFile.getFile());
+
+            if (out.openedOk())
+            {
+                out.writeInt (magicNumber);
+                out.writeInt (formatVersion);
+                out.writeInt64 (newTableStamp.size);
+                out.writeInt64 (newTableStamp.modificationTime);
+
+                if (endOfRecordsToKeep > startOfRecordsToKeep)
+                    out.write (static_cast<const char*> (oldJournal.getData()) + startOfRecordsToKeep,
+                               (size_t) (endOfRecordsToKeep - startOfRecordsToKeep));
+            }
+        }
+
+        if (! tempFile.overwriteTargetFileWithTemporary())
+            DBG ("Couldn't replace " << journalFile.getFullPathName());
+
+        tableStamp = newTableStamp;
+        reopen();
+    }
+
+    void reopen()
+    {
+       #if JUCE_WINDOWS
+        file = ::_wfopen (journalFile.getFullPathName().toWideCharPointer(), L"ab");
+       #else
+        file = std::fopen (journalFile.getFullPathName().toRawUTF8(), "ab");
+       #endif
+
+        const juce::ScopedLock sl (queueLock);
+        size = journalFile.getSize() + (juce::int64) queuedBytes.size();
+    }
+
+    static bool syncToDisk (std::FILE* f)
+    {
+       #if JUCE_WINDOWS
+        return ::_commit (::_fileno (f)) == 0;
+       #else
+        return ::fsync (::fileno (f)) == 0;
+       #endif
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TableJournal)
+};
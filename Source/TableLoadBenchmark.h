@@ -0,0 +1,174 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableRowStore.h"
+#include "TableDataReader.h"
+//==============================================================================
+/**
+    Times the different ways of loading a table file, for comparing startup costs.
+    The snapshot is written from the rows XmlDocument::parse() produced, and opening
+    it is timed like the other loaders.
+
+    Run ValuePropertyWndBenchmarks, the console build in Benchmarks, with
+    "--benchmark-load <file>" to print the report.
+*/
+class TableLoadBenchmark
+{
+public:
+    /** Loads a table file numRuns times with each loader, and returns a report of each
+        loader's best time and whether it produced the same rows as XmlDocument::parse().
+    */
+    static juce::String run (const juce::File& tableFile, int numRuns = 3)
+    {
+        juce::String report;
+        report << "Loading " << tableFile.getFullPathName()
+               << " (" << juce::File::descriptionOfSizeInBytes (tableFile.getSize()) << ") on "
+               << juce::SystemStats::getNumCpus() << " CPU(s), best of " << numRuns << juce::newLine;
+
+        TableRowStore reference;
+        double referenceMilliseconds = 0.0;
+
+        auto timeLoader = [&] (const char* name, const std::function<bool (TableRowStore&)>& load)
+        {
+            TableRowStore store;
+            auto ok = true;
+            auto best = std::numeric_limits<double>::max();
+
+            for (int i = 0; i < numRuns && ok; ++i)
+            {
+                const auto startTime = juce::Time::getMillisecondCounterHiRes();
+                ok = load (store);
+                best = juce::jmin (best, juce::Time::getMillisecondCounterHiRes() - startTime);
+            }
+
+            report << "  " << juce::String (name).paddedRight (' ', 22);
+
+            if (! ok)
+            {
+                report << "failed" << juce::newLine;
+                return;
+            }
+
+            if (referenceMilliseconds == 0.0)
+            {
+                reference = store;
+                referenceMilliseconds = best;
+            }
+
+            report << juce::String (best, 1).paddedLeft (' ', 10) << " ms  "
+                   << juce::String (store.getNumRows()).paddedLeft (' ', 9) << " rows  "
+                   << "x" << juce::String (referenceMilliseconds / juce::jmax (best, 0.001), 2)
+                   << (haveSameRows (store, reference) ? "" : "  ROWS DIFFER") << juce::newLine;
+        };
+
+        timeLoader ("XmlDocument::parse", [&] (TableRowStore& store)
+        {
+            auto tableXml = juce::XmlDocument::parse (tableFile);
+            return tableXml != nullptr && store.loadFromXml (*tableXml);
+        });
+
+        timeLoader ("TableDataReader", [&] (TableRowStore& store)
+        {
+            return loadWithReader (store, [&] (TableDataReader& reader)
+            {
+                juce::FileInputStream input (tableFile);
+                return input.openedOk() && reader.read (input);
+            });
+        });
+
+        timeLoader ("parallel, mapped", [&] (TableRowStore& store)
+        {
+            juce::SharedResourcePointer<WorkerThreads> workers;
+
+            return loadWithReader (store, [&] (TableDataReader& reader)
+            {
+                juce::MemoryMappedFile mappedFile (tableFile, juce::MemoryMappedFile::readOnly);
+
+                return mappedFile.getData() != nullptr
+                        && reader.readInParallel (mappedFile.getData(), mappedFile.getSize(),
+                                                  *workers, juce::SystemStats::getNumCpus());
+            });
+        });
+
+        // the snapshot goes to a temporary file, to leave the app's own one alone
+        juce::TemporaryFile snapshotFile (TableSnapshot::getFileFor (tableFile));
+
+        if (reference.writeSnapshot (snapshotFile.getFile(), TableSnapshot::getSourceStamp (tableFile)))
+        {
+            timeLoader ("snapshot, mapped", [&] (TableRowStore& store)
+            {
+                auto snapshot = TableSnapshot::open (snapshotFile.getFile(), tableFile);
+
+                if (snapshot == nullptr)
+                    return false;
+
+                store.setSnapshot (std::move (snapshot));
+                return true;
+            });
+        }
+
+        reportDictionaryEncoding (reference, report);
+        return report;
+    }
+
+private:
+    /** Encodes a copy of a loaded table's low-cardinality columns, and reports how long
+        that took and how much memory each column saved.
+    */
+    static void reportDictionaryEncoding (TableRowStore store, juce::String& report)
+    {
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+        const auto encodedColumns = store.encodeLowCardinalityColumns();
+        const auto milliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+        report << "Dictionary encoding: " << (int) encodedColumns.size() << " column(s) in "
+               << juce::String (milliseconds, 1) << " ms" << juce::newLine;
+
+        size_t totalSaved = 0;
+
+        for (auto& encoded : encodedColumns)
+        {
+            const auto saved = encoded.numBytesBefore - juce::jmin (encoded.numBytesBefore, encoded.numBytesAfter);
+            totalSaved += saved;
+
+            report << "  " << store.getSchema().getColumn (encoded.slot).name.toString().paddedRight (' ', 22)
+                   << juce::String (encoded.numValues).paddedLeft (' ', 7) << " values  "
+                   << juce::File::descriptionOfSizeInBytes ((juce::int64) encoded.numBytesBefore).paddedLeft (' ', 10) << " -> "
+                   << juce::File::descriptionOfSizeInBytes ((juce::int64) encoded.numBytesAfter).paddedLeft (' ', 10) << "  saved "
+                   << juce::File::descriptionOfSizeInBytes ((juce::int64) saved) << juce::newLine;
+        }
+
+        if (! encodedColumns.empty())
+            report << "  total saved " << juce::File::descriptionOfSizeInBytes ((juce::int64) totalSaved) << juce::newLine;
+    }
+
+    template <typename ReadFunction>
+    static bool loadWithReader (TableRowStore& store, ReadFunction&& read)
+    {
+        TableDataReader reader;
+        reader.onSchemaRead = [&store] (const TableColumnSchema& schema)               { store.setSchema (schema); };
+        reader.onRowsRead   = [&store] (std::vector<juce::String>&& cells, int numRows) { store.appendRows (std::move (cells), numRows); };
+
+        store.clear();
+        return read (reader);
+    }
+
+    static bool haveSameRows (const TableRowStore& a, const TableRowStore& b)
+    {
+        if (a.getNumRows() != b.getNumRows() || a.getNumColumns() != b.getNumColumns())
+            return false;
+
+        for (int slot = 0; slot < a.getNumColumns(); ++slot)
+            if (a.getSchema().getColumn (slot).columnId != b.getSchema().getColumn (slot).columnId
+                 || a.getSchema().getColumn (slot).name != b.getSchema().getColumn (slot).name)
+                return false;
+
+        juce::String textA, textB;
+
+        for (int row = 0; row < a.getNumRows(); ++row)
+            for (int slot = 0; slot < a.getNumColumns(); ++slot)
+                if (a.getCellText (row, slot, textA) != b.getCellText (row, slot, textB))
+                    return false;
+
+        return true;
+    }
+};
@@ -0,0 +1,532 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableColumnSchema.h"
+#include "TableDataReader.h"
+#include "TableSnapshot.h"
+#include "TypedColumn.h"
+#include "DictionaryColumn.h"
+//==============================================================================
+/**
+    Random-access storage for the rows of a TableData.xml file.
+
+    loadFromXml() copies every <ITEM> of the <DATA> section into one contiguous
+    array of row records (one juce::String per text column), so looking up a
+    cell costs the same whether it's in the first row or the last. Columns that
+    declare a type are kept apart from the records, as native values in a
+    TypedColumn. The XML DOM is only used to import the data and to export it again
+    with createXml().
+
+    Once a table has been loaded, encodeLowCardinalityColumns() moves the text
+    columns that repeat a few values over and over out of the records as well, into
+    DictionaryColumns.
+
+    A table can also be filled a batch at a time with setSchema() and appendRows(),
+    which is how TableDataReader streams a file in while it's being displayed.
+    Rows keep their index as more are appended.
+
+    Alternatively the store can serve its cells straight out of a memory-mapped
+    TableSnapshot, in which case the cells that get edited are kept in memory on
+    top of it.
+
+    Copying a store is cheap, because the copies share their cells: each chunk of
+    records, each column and the edited cells are only copied when one of the stores
+    changes them while they're shared. So a copy can be handed to a background thread as a table
+    that won't change under it, while the original carries on being edited.
+*/
+class TableRowStore
+{
+public:
+    void clear()
+    {
+        schema.clear();
+        recordChunks.clear();
+        typedColumns.clear();
+        dictionaryColumns.clear();
+        storage.clear();
+        numTextColumns = 0;
+        numRows = 0;
+        snapshot = nullptr;
+        editedCells = nullptr;
+    }
+
+    /** Replaces the contents of the store with the <HEADERS> and <DATA> of a table. */
+    bool loadFromXml (const juce::XmlElement& tableXml)
+    {
+        clear();
+
+        auto* headersXml = tableXml.getChildByName ("HEADERS");
+        auto* dataXml    = tableXml.getChildByName ("DATA");
+
+        if (headersXml == nullptr || dataXml == nullptr)
+            return false;
+
+        schema.loadFromXml (*headersXml);
+        prepareStorage();
+
+        const auto numColumns = schema.getNumColumns();
+        const auto numRowsExpected = dataXml->getNumChildElements();
+
+        for (auto& typedColumn : typedColumns)
+            typedColumn->reserve (numRowsExpected);
+
+        for (auto* rowXml : dataXml->getChildIterator())
+        {
+            for (int slot = 0; slot < numColumns; ++slot)
+                appendCell (slot, rowXml->getStringAttribute (schema.getColumn (slot).name));
+
+            ++numRows;
+        }
+
+        return true;
+    }
+
+    /** Reads a table file on the calling thread, using all the worker threads for big files. */
+    bool loadFromFile (const juce::File& tableFile, const std::function<bool()>& shouldExit = {})
+    {
+        juce::SharedResourcePointer<WorkerThreads> workers;
+        TableDataReader reader;
+        reader.onSchemaRead = [this] (const TableColumnSchema& newSchema)                  { setSchema (newSchema); };
+        reader.onRowsRead   = [this] (std::vector<juce::String>&& newCells, int numNewRows) { appendRows (std::move (newCells), numNewRows); };
+        reader.shouldExit = shouldExit;
+
+        clear();
+        return reader.readFile (tableFile, *workers);
+    }
+
+    /** Replaces the contents of the store with a snapshot, which it serves cells from directly. */
+    void setSnapshot (std::shared_ptr<const TableSnapshot> newSnapshot)
+    {
+        clear();
+        snapshot = std::move (newSnapshot);
+        schema = snapshot->getSchema();
+        numRows = snapshot->getNumRows();
+    }
+
+    /** Writes the contents of the store to a snapshot file, leaving out any rows that
+        shouldWriteRow (row) returns false for. sourceStamp should describe the file that
+        holds the same rows, as it was just before it was read or just after it was written.
+    */
+    bool writeSnapshot (const juce::File& snapshotFile, const TableSnapshot::FileInfo& sourceStamp,
+                        const std::function<bool (int)>& shouldWriteRow = {}) const
+    {
+        if (shouldWriteRow == nullptr)
+            return TableSnapshot::write (snapshotFile, sourceStamp, schema, numRows,
+                                         [this] (int row, int slot) { return getCell (row, slot); });
+
+        std::vector<int> rowsToWrite;
+
+        for (int row = 0; row < numRows; ++row)
+            if (shouldWriteRow (row))
+                rowsToWrite.push_back (row);
+
+        return TableSnapshot::write (snapshotFile, sourceStamp, schema, (int) rowsToWrite.size(),
+                                     [this, &rowsToWrite] (int row, int slot) { return getCell (rowsToWrite[(size_t) row], slot); });
+    }
+
+    /** Empties the store and sets the columns that appended rows will have. */
+    void setSchema (const TableColumnSchema& newSchema)
+    {
+        clear();
+        schema = newSchema;
+        prepareStorage();
+    }
+
+    /** Adds numNewRows rows to the end of the store, given as numNewRows records of
+        getNumColumns() cells each.
+    */
+    void appendRows (std::vector<juce::String>&& newCells, int numNewRows)
+    {
+        jassert (snapshot == nullptr && newCells.size() == (size_t) numNewRows * (size_t) getNumColumns());
+
+        for (size_t i = 0; i < newCells.size(); ++i)
+            appendCell ((int) (i % (size_t) getNumColumns()), std::move (newCells[i]));
+
+        numRows += numNewRows;
+    }
+
+    /** Builds a TableData.xml document from the current contents of the store, leaving
+        out any rows that shouldWriteRow (row) returns false for.
+    */
+    std::unique_ptr<juce::XmlElement> createXml (const std::function<bool (int)>& shouldWriteRow = {}) const
+    {
+        auto tableXml = std::make_unique<juce::XmlElement> ("TABLE_DATA");
+        schema.writeToXml (*tableXml->createNewChildElement ("HEADERS"));
+        auto* dataXml = tableXml->createNewChildElement ("DATA");
+
+        for (int row = 0; row < numRows; ++row)
+        {
+            if (shouldWriteRow != nullptr && ! shouldWriteRow (row))
+                continue;
+
+            auto* rowXml = dataXml->createNewChildElement ("ITEM");
+
+            for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+                rowXml->setAttribute (schema.getColumn (slot).name, getCell (row, slot));
+        }
+
+        return tableXml;
+    }
+
+    //==============================================================================
+    int getNumRows() const noexcept                         { return numRows; }
+    int getNumColumns() const noexcept                      { return schema.getNumColumns(); }
+    const TableColumnSchema& getSchema() const noexcept     { return schema; }
+
+    /** Returns the text of a cell without copying it. The text of a record, dictionary or
+        snapshot cell is referred to where the store keeps it, and stays valid until the
+        cell is changed or the store is reloaded. A typed cell has no text to refer to, so
+        it's formatted from its value into formattedText, which the result then refers to.
+    */
+    juce::StringRef getCellText (int row, int slot, juce::String& formattedText) const
+    {
+        if (! (juce::isPositiveAndBelow (row, numRows) && juce::isPositiveAndBelow (slot, getNumColumns())))
+            return {};
+
+        if (snapshot != nullptr)
+        {
+            if (editedCells != nullptr)
+                if (auto edited = editedCells->find ((size_t) row * (size_t) getNumColumns() + (size_t) slot); edited != editedCells->end())
+                    return edited->second;
+
+            return snapshot->getCell (row, slot);
+        }
+
+        auto [kind, index] = storage[(size_t) slot];
+
+        switch (kind)
+        {
+            case StorageKind::record:       return getRecordCell (row, index);
+            case StorageKind::typed:        return formattedText = typedColumns[(size_t) index]->getText (row);
+            case StorageKind::dictionary:   return dictionaryColumns[(size_t) index]->getText (row);
+        }
+
+        return {};
+    }
+
+    /** Returns a copy of the text of a cell, to keep or to hand on. Text columns just
+        share their string, but a snapshot cell gets copied out of the mapped file and a
+        typed cell formatted from its value, so cells that are only looked at are cheaper
+        to read with getCellText().
+    */
+    juce::String getCell (int row, int slot) const
+    {
+        if (! (juce::isPositiveAndBelow (row, numRows) && juce::isPositiveAndBelow (slot, getNumColumns())))
+            return {};
+
+        if (snapshot != nullptr)
+        {
+            const auto cellIndex = (size_t) row * (size_t) getNumColumns() + (size_t) slot;
+
+            if (editedCells != nullptr)
+                if (auto edited = editedCells->find (cellIndex); edited != editedCells->end())
+                    return edited->second;
+
+            return snapshot->getCell (row, slot);
+        }
+
+        auto [kind, index] = storage[(size_t) slot];
+
+        switch (kind)
+        {
+            case StorageKind::record:       return getRecordCell (row, index);
+            case StorageKind::typed:        return typedColumns[(size_t) index]->getText (row);
+            case StorageKind::dictionary:   return dictionaryColumns[(size_t) index]->getText (row);
+        }
+
+        return {};
+    }
+
+    /** Changes the text of a cell. Returns true if that changed the sort keys of other
+        cells in the column too, as adding a value to a dictionary-encoded column does.
+    */
+    bool setCell (int row, int slot, const juce::String& newText)
+    {
+        if (! (juce::isPositiveAndBelow (row, numRows) && juce::isPositiveAndBelow (slot, getNumColumns())))
+            return false;
+
+        if (snapshot != nullptr)
+        {
+            if (editedCells == nullptr)
+                editedCells = std::make_shared<std::unordered_map<size_t, juce::String>>();
+
+            getPartToModify (editedCells)[(size_t) row * (size_t) getNumColumns() + (size_t) slot] = newText;
+            return false;
+        }
+
+        auto [kind, index] = storage[(size_t) slot];
+
+        switch (kind)
+        {
+            case StorageKind::record:       getRecordCellToModify (row, index) = newText; break;
+            case StorageKind::typed:        getPartToModify (typedColumns[(size_t) index]).set (row, newText); break;
+            case StorageKind::dictionary:   return getPartToModify (dictionaryColumns[(size_t) index]).set (row, newText);
+        }
+
+        return false;
+    }
+
+    /** Returns true if the store can supply sort keys for a column, which it can for typed
+        and dictionary-encoded columns. Other columns are sorted by their text.
+    */
+    bool hasSortKeys (int slot) const noexcept
+    {
+        if (! juce::isPositiveAndBelow (slot, getNumColumns()))
+            return false;
+
+        if (snapshot != nullptr)
+            return ! schema.getColumn (slot).isText();
+
+        return storage[(size_t) slot].kind != StorageKind::record;
+    }
+
+    /** Returns the sort key of a cell in a column that hasSortKeys(). */
+    juce::uint64 getSortKey (int row, int slot) const
+    {
+        jassert (hasSortKeys (slot));
+
+        if (snapshot != nullptr)
+            return TypedColumn::getSortKey (schema.getColumn (slot).type, getCell (row, slot));
+
+        auto [kind, index] = storage[(size_t) slot];
+
+        return kind == StorageKind::dictionary ? dictionaryColumns[(size_t) index]->getSortKey (row)
+                                               : typedColumns[(size_t) index]->getSortKey (row);
+    }
+
+    /** Returns the sort key some text would have in a column that hasSortKeys(), so that
+        cells can be compared with it.
+    */
+    juce::uint64 getSortKeyFor (int slot, const juce::String& text) const
+    {
+        jassert (hasSortKeys (slot));
+
+        if (snapshot == nullptr && storage[(size_t) slot].kind == StorageKind::dictionary)
+            return dictionaryColumns[(size_t) storage[(size_t) slot].index]->getSortKeyFor (text);
+
+        return TypedColumn::getSortKey (schema.getColumn (slot).type, text);
+    }
+
+    /** Returns the sort keys of every cell in a column that hasSortKeys(), indexed by row. */
+    std::vector<juce::uint64> getSortKeys (int slot) const
+    {
+        std::vector<juce::uint64> keys;
+        keys.reserve ((size_t) numRows);
+
+        for (int row = 0; row < numRows; ++row)
+            keys.push_back (getSortKey (row, slot));
+
+        return keys;
+    }
+
+    /** Returns true if a cell holds a true boolean, whether or not its column is typed. */
+    bool getBoolean (int row, int slot) const
+    {
+        if (snapshot == nullptr && juce::isPositiveAndBelow (slot, getNumColumns())
+             && schema.getColumn (slot).type == TableColumnSchema::ColumnType::boolean)
+            return typedColumns[(size_t) storage[(size_t) slot].index]->getBoolean (row);
+
+        return TypedColumn::getSortKey (TableColumnSchema::ColumnType::boolean, getCell (row, slot)) == 2;
+    }
+
+    bool isServedFromSnapshot() const noexcept              { return snapshot != nullptr; }
+
+    //==============================================================================
+    /** How much memory encoding a column saved. */
+    struct EncodedColumn
+    {
+        int slot;
+        int numValues;
+        size_t numBytesBefore, numBytesAfter;
+    };
+
+    /** Dictionary-encodes every text column that has at most one different value for
+        every minRowsPerValue rows, if that makes it smaller, and returns an estimate of
+        the memory each encoded column saved. Typed columns and tables served from a
+        snapshot are left alone.
+    */
+    std::vector<EncodedColumn> encodeLowCardinalityColumns (int minRowsPerValue = 8)
+    {
+        std::vector<EncodedColumn> encodedColumns;
+
+        if (snapshot != nullptr)
+            return encodedColumns;
+
+        const auto maxNumValues = juce::jmin (0x10000, numRows / juce::jmax (1, minRowsPerValue));
+
+        for (int slot = 0; slot < getNumColumns(); ++slot)
+        {
+            auto [kind, index] = storage[(size_t) slot];
+
+            if (kind != StorageKind::record || maxNumValues == 0)
+                continue;
+
+            auto getColumnCell = [this, index = index] (int row) -> const juce::String&
+            {
+                return getRecordCell (row, index);
+            };
+
+            auto dictionaryColumn = DictionaryColumn::encode (numRows, getColumnCell, maxNumValues);
+
+            if (! dictionaryColumn.has_value())
+                continue;
+
+            size_t numBytesBefore = 0;
+
+            for (int row = 0; row < numRows; ++row)
+                numBytesBefore += DictionaryColumn::getNumBytesUsed (getColumnCell (row));
+
+            const auto numBytesAfter = dictionaryColumn->getNumBytesUsed();
+
+            if (numBytesAfter >= numBytesBefore)
+                continue;
+
+            encodedColumns.push_back ({ slot, dictionaryColumn->getNumValues(), numBytesBefore, numBytesAfter });
+            storage[(size_t) slot] = { StorageKind::dictionary, (int) dictionaryColumns.size() };
+            dictionaryColumns.push_back (std::make_shared<DictionaryColumn> (std::move (*dictionaryColumn)));
+        }
+
+        if (! encodedColumns.empty())
+            removeEncodedColumnsFromRecords();
+
+        return encodedColumns;
+    }
+
+    /** Copies the cells of one column, e.g. to hand them to a background thread. */
+    std::vector<juce::String> getColumnSnapshot (int slot) const
+    {
+        std::vector<juce::String> snapshot;
+        snapshot.reserve ((size_t) numRows);
+
+        for (int row = 0; row < numRows; ++row)
+            snapshot.push_back (getCell (row, slot));
+
+        return snapshot;
+    }
+
+private:
+    TableColumnSchema schema;
+    static constexpr int rowsPerChunk = 4096;
+    using RecordChunk = std::vector<juce::String>;                  // rowsPerChunk records of numTextColumns cells each
+    std::vector<std::shared_ptr<RecordChunk>> recordChunks;         // so that an edit copies one chunk of a shared store
+    std::vector<std::shared_ptr<TypedColumn>> typedColumns;
+    std::vector<std::shared_ptr<DictionaryColumn>> dictionaryColumns;
+    int numTextColumns = 0;
+
+    enum class StorageKind
+    {
+        record,
+        typed,
+        dictionary
+    };
+
+    struct Storage
+    {
+        StorageKind kind;
+        int index;  // in a record, or in typedColumns or dictionaryColumns
+    };
+
+    std::vector<Storage> storage;   // per slot
+    int numRows = 0;
+
+    std::shared_ptr<const TableSnapshot> snapshot;
+    std::shared_ptr<std::unordered_map<size_t, juce::String>> editedCells;   // by cell index, when serving a snapshot
+
+    /** Returns a part of the store that's about to be changed, copying it first if another
+        store shares it.
+    */
+    template <typename Part>
+    static Part& getPartToModify (std::shared_ptr<Part>& part)
+    {
+        if (part.use_count() > 1)
+            part = std::make_shared<Part> (*part);
+
+        return *part;
+    }
+
+    const juce::String& getRecordCell (int row, int index) const noexcept
+    {
+        return (*recordChunks[(size_t) (row / rowsPerChunk)])[(size_t) (row % rowsPerChunk) * (size_t) numTextColumns + (size_t) index];
+    }
+
+    juce::String& getRecordCellToModify (int row, int index)
+    {
+        auto& chunk = getPartToModify (recordChunks[(size_t) (row / rowsPerChunk)]);
+        return chunk[(size_t) (row % rowsPerChunk) * (size_t) numTextColumns + (size_t) index];
+    }
+
+    /** Appends a cell to the record being added, starting a new chunk after a full one. */
+    void appendRecordCell (juce::String text)
+    {
+        const auto chunkSize = (size_t) rowsPerChunk * (size_t) numTextColumns;
+
+        if (recordChunks.empty() || recordChunks.back()->size() == chunkSize)
+        {
+            recordChunks.push_back (std::make_shared<RecordChunk>());
+            recordChunks.back()->reserve (chunkSize);
+        }
+
+        getPartToModify (recordChunks.back()).push_back (std::move (text));
+    }
+
+    void prepareStorage()
+    {
+        recordChunks.clear();
+        typedColumns.clear();
+        dictionaryColumns.clear();
+        storage.clear();
+        numTextColumns = 0;
+
+        for (int slot = 0; slot < schema.getNumColumns(); ++slot)
+        {
+            auto& column = schema.getColumn (slot);
+
+            if (column.isText())
+            {
+                storage.push_back ({ StorageKind::record, numTextColumns++ });
+            }
+            else
+            {
+                storage.push_back ({ StorageKind::typed, (int) typedColumns.size() });
+                typedColumns.push_back (std::make_shared<TypedColumn> (column.type));
+            }
+        }
+    }
+
+    /** Appends a cell to the row being added, which must be filled in slot order. */
+    void appendCell (int slot, juce::String text)
+    {
+        auto [kind, index] = storage[(size_t) slot];
+
+        switch (kind)
+        {
+            case StorageKind::record:       appendRecordCell (std::move (text)); break;
+            case StorageKind::typed:        getPartToModify (typedColumns[(size_t) index]).append (text); break;
+            case StorageKind::dictionary:   getPartToModify (dictionaryColumns[(size_t) index]).append (text); break;
+        }
+    }
+
+    /** Rebuilds the records without the cells of columns that have just been encoded. */
+    void removeEncodedColumnsFromRecords()
+    {
+        std::vector<int> oldIndexes;
+
+        for (auto& slotStorage : storage)
+        {
+            if (slotStorage.kind == StorageKind::record)
+            {
+                oldIndexes.push_back (slotStorage.index);
+                slotStorage.index = (int) oldIndexes.size() - 1;
+            }
+        }
+
+        auto oldChunks = std::move (recordChunks);
+        auto oldNumTextColumns = std::exchange (numTextColumns, (int) oldIndexes.size());
+        recordChunks.clear();
+
+        for (int row = 0; row < numRows; ++row)
+            for (auto oldIndex : oldIndexes)
+                appendRecordCell ((*oldChunks[(size_t) (row / rowsPerChunk)])[(size_t) (row % rowsPerChunk) * (size_t) oldNumTextColumns + (size_t) oldIndex]);
+    }
+
+    JUCE_LEAK_DETECTOR (TableRowStore)
+};
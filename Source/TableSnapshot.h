@@ -0,0 +1,287 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TableColumnSchema.h"
+//==============================================================================
+/**
+    A read-only binary copy of a table, memory-mapped so that opening it costs the
+    same whatever the size of the table, and so that several instances of the app
+    share the same pages.
+
+    The file is laid out as:
+
+    - a FileHeader, which records the size and modification time of the XML file the
+      snapshot was made from, so that a stale snapshot can be spotted and ignored
+    - one ColumnHeader per schema slot, which includes the column's declared type
+    - the column names, each null-terminated
+    - for each column, a table of numRows + 1 offsets into that column's string
+      heap, followed by the heap itself, which holds every cell as null-terminated
+      UTF-8
+
+    Cells are returned as juce::StringRefs pointing straight into the mapped file.
+    Typed columns are stored as text too, and parsed when they're sorted.
+    Numbers are stored in the byte order of the machine that wrote the snapshot;
+    a snapshot from a machine with a different byte order fails the header check.
+*/
+class TableSnapshot
+{
+public:
+    /** Returns the file that the snapshot of a table file is kept in. */
+    static juce::File getFileFor (const juce::File& tableFile)
+    {
+        return tableFile.getSiblingFile (tableFile.getFileName() + ".snapshot");
+    }
+
+    /** The size and modification time of a source file, as recorded in a snapshot. */
+    struct FileInfo
+    {
+        juce::int64 size = 0;
+        juce::int64 modificationTime = 0;
+
+        bool operator== (const FileInfo& other) const noexcept  { return size == other.size && modificationTime == other.modificationTime; }
+        bool operator!= (const FileInfo& other) const noexcept  { return ! operator== (other); }
+    };
+
+    static FileInfo getSourceStamp (const juce::File& sourceFile)
+    {
+        return { sourceFile.getSize(), sourceFile.getLastModificationTime().toMilliseconds() };
+    }
+
+    /** Maps a snapshot, returning nullptr if it's missing, damaged, or wasn't made from
+        the current version of sourceFile.
+    */
+    static std::unique_ptr<TableSnapshot> open (const juce::File& snapshotFile, const juce::File& sourceFile)
+    {
+        if (! snapshotFile.existsAsFile())
+            return nullptr;
+
+        std::unique_ptr<TableSnapshot> snapshot (new TableSnapshot (snapshotFile));
+
+        if (! snapshot->readLayout (getSourceStamp (sourceFile)))
+            return nullptr;
+
+        return snapshot;
+    }
+
+    /** Writes a snapshot of a table, stamped with the size and modification time that its
+        source file had when the table was read from it. getCell (row, slot) supplies the
+        cells. The file is replaced in one go, so a reader never sees half a snapshot.
+    */
+    template <typename CellFunction>
+    static bool write (const juce::File& snapshotFile, const FileInfo& sourceStamp,
+                       const TableColumnSchema& schema, int numRows, CellFunction&& getCell)
+    {
+        juce::TemporaryFile tempFile (snapshotFile);
+
+        {
+            juce::FileOutputStream out (tempFile.getFile());
+
+            if (! out.openedOk())
+                return false;
+
+            const auto numColumns = schema.getNumColumns();
+
+            FileHeader header;
+            std::memcpy (header.magic, magicNumber, sizeof (header.magic));
+            header.numColumns = (juce::uint32) numColumns;
+            header.numRows = (juce::uint32) numRows;
+            header.sourceSize = sourceStamp.size;
+            header.sourceModificationTime = sourceStamp.modificationTime;
+
+            // the names follow the column headers, then each column's offsets and heap
+            std::vector<ColumnHeader> columnHeaders ((size_t) numColumns);
+            std::vector<char> names;
+            auto position = sizeof (FileHeader) + columnHeaders.size() * sizeof (ColumnHeader);
+
+            for (int slot = 0; slot < numColumns; ++slot)
+            {
+                auto& column = schema.getColumn (slot);
+                auto& columnHeader = columnHeaders[(size_t) slot];
+                columnHeader.columnId = column.columnId;
+                columnHeader.width = column.width;
+                columnHeader.type = (juce::int32) column.type;
+                columnHeader.nameOffset = position + names.size();
+
+                auto name = column.name.toString();
+                names.insert (names.end(), name.toRawUTF8(), name.toRawUTF8() + name.getNumBytesAsUTF8() + 1);
+            }
+
+            names.resize (alignedSize (names.size()), 0);
+            position += names.size();
+
+            // work out where every column's heap goes before writing anything
+            std::vector<std::vector<juce::uint32>> offsets ((size_t) numColumns);
+
+            for (int slot = 0; slot < numColumns; ++slot)
+            {
+                auto& columnOffsets = offsets[(size_t) slot];
+                columnOffsets.reserve ((size_t) numRows + 1);
+
+                juce::uint64 heapSize = 0;
+
+                for (int row = 0; row < numRows; ++row)
+                {
+                    columnOffsets.push_back ((juce::uint32) heapSize);
+                    heapSize += juce::StringRef (getCell (row, slot)).text.sizeInBytes();
+
+                    if (heapSize > std::numeric_limits<juce::uint32>::max())
+                        return false;
+                }
+
+                columnOffsets.push_back ((juce::uint32) heapSize);
+
+                auto& columnHeader = columnHeaders[(size_t) slot];
+                columnHeader.offsetsOffset = position;
+                position += alignedSize (columnOffsets.size() * sizeof (juce::uint32));
+                columnHeader.heapOffset = position;
+                position += alignedSize ((size_t) heapSize);
+            }
+
+            header.fileSize = position;
+
+            out.write (&header, sizeof (header));
+            out.write (columnHeaders.data(), columnHeaders.size() * sizeof (ColumnHeader));
+            out.write (names.data(), names.size());
+
+            for (int slot = 0; slot < numColumns; ++slot)
+            {
+                auto& columnOffsets = offsets[(size_t) slot];
+                writeAligned (out, columnOffsets.data(), columnOffsets.size() * sizeof (juce::uint32));
+
+                for (int row = 0; row < numRows; ++row)
+                {
+                    const auto& cell = getCell (row, slot);
+                    juce::StringRef text (cell);
+                    out.write (text.text.getAddress(), text.text.sizeInBytes());
+                }
+
+                writeAligned (out, nullptr, columnOffsets.back());
+            }
+
+            out.flush();
+
+            if (out.getStatus().failed() || (juce::uint64) out.getPosition() != position)
+                return false;
+        }
+
+        return tempFile.overwriteTargetFileWithTemporary();
+    }
+
+    //==============================================================================
+    const TableColumnSchema& getSchema() const noexcept     { return schema; }
+    int getNumRows() const noexcept                         { return numRows; }
+
+    /** Returns the text of a cell, which stays valid for as long as the snapshot is open. */
+    juce::StringRef getCell (int row, int slot) const noexcept
+    {
+        auto& column = columns[(size_t) slot];
+        return juce::CharPointer_UTF8 (column.heap + column.offsets[(size_t) row]);
+    }
+
+private:
+    // 03 turns away the snapshots of earlier builds, which could have unsaved edits in them
+    static constexpr char magicNumber[8] = { 'T', 'B', 'L', 'S', 'N', 'P', '0', '3' };
+    static constexpr juce::uint32 byteOrderMark = 0x01020304;
+
+    struct FileHeader
+    {
+        char magic[8];
+        juce::uint32 byteOrder = byteOrderMark;
+        juce::uint32 numColumns = 0;
+        juce::uint32 numRows = 0;
+        juce::uint32 reserved = 0;
+        juce::int64 sourceSize = 0;
+        juce::int64 sourceModificationTime = 0;
+        juce::uint64 fileSize = 0;
+    };
+
+    struct ColumnHeader
+    {
+        juce::int32 columnId = 0;
+        juce::int32 width = 0;
+        juce::int32 type = 0;
+        juce::int32 reserved = 0;
+        juce::uint64 nameOffset = 0;
+        juce::uint64 offsetsOffset = 0;
+        juce::uint64 heapOffset = 0;
+    };
+
+    struct Column
+    {
+        const juce::uint32* offsets;
+        const char* heap;
+    };
+
+    juce::MemoryMappedFile mappedFile;
+    TableColumnSchema schema;
+    std::vector<Column> columns;
+    int numRows = 0;
+
+    explicit TableSnapshot (const juce::File& snapshotFile)
+        : mappedFile (snapshotFile, juce::MemoryMappedFile::readOnly)
+    {}
+
+    static size_t alignedSize (size_t numBytes) noexcept     { return (numBytes + 7) & ~(size_t) 7; }
+
+    static void writeAligned (juce::OutputStream& out, const void* data, size_t numBytes)
+    {
+        if (data != nullptr)
+            out.write (data, numBytes);
+
+        const char padding[8] = {};
+        out.write (padding, alignedSize (numBytes) - numBytes);
+    }
+
+    bool readLayout (const FileInfo& sourceStamp)
+    {
+        auto* data = static_cast<const char*> (mappedFile.getData());
+        const auto size = (juce::uint64) mappedFile.getSize();
+
+        if (data == nullptr || size < sizeof (FileHeader))
+            return false;
+
+        auto& header = *reinterpret_cast<const FileHeader*> (data);
+
+        if (std::memcmp (header.magic, magicNumber, sizeof (header.magic)) != 0
+             || header.byteOrder != byteOrderMark
+             || header.fileSize != size
+             || header.sourceSize != sourceStamp.size
+             || header.sourceModificationTime != sourceStamp.modificationTime
+             || header.numRows > (juce::uint32) std::numeric_limits<int>::max()
+             || sizeof (FileHeader) + (juce::uint64) header.numColumns * sizeof (ColumnHeader) > size)
+            return false;
+
+        numRows = (int) header.numRows;
+        auto* columnHeaders = reinterpret_cast<const ColumnHeader*> (data + sizeof (FileHeader));
+
+        for (juce::uint32 i = 0; i < header.numColumns; ++i)
+        {
+            auto& columnHeader = columnHeaders[i];
+            const auto offsetsSize = ((juce::uint64) numRows + 1) * sizeof (juce::uint32);
+
+            if (columnHeader.nameOffset >= size
+                 || ! juce::isPositiveAndNotGreaterThan (columnHeader.type, (juce::int32) TableColumnSchema::ColumnType::version)
+                 || columnHeader.offsetsOffset + offsetsSize > columnHeader.heapOffset
+                 || columnHeader.heapOffset > size)
+                return false;
+
+            auto* offsets = reinterpret_cast<const juce::uint32*> (data + columnHeader.offsetsOffset);
+
+            // the offset tables themselves aren't checked, as that would mean touching
+            // every page; the file is only ever written whole, by write()
+            if (columnHeader.heapOffset + offsets[numRows] > size
+                 || (offsets[numRows] > 0 && data[columnHeader.heapOffset + offsets[numRows] - 1] != 0))
+                return false;
+
+            auto* name = data + columnHeader.nameOffset;
+            schema.addColumn (columnHeader.columnId,
+                              juce::String::fromUTF8 (name, (int) strnlen (name, (size_t) (size - columnHeader.nameOffset))),
+                              columnHeader.width,
+                              (TableColumnSchema::ColumnType) columnHeader.type);
+            columns.push_back ({ offsets, data + columnHeader.heapOffset });
+        }
+
+        return schema.getNumColumns() == (int) header.numColumns;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TableSnapshot)
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    Maps the rows shown by the TableListBox onto rows of the TableRowStore.
+
+    The store never moves its rows, so sorting only has to produce a list of store
+    rows in the new order. A store row therefore identifies the same item (and the
+    same ID) for as long as the table is loaded, which is what the selection and
+    the Select toggles are tracked by.
+
+    A sorted list is always kept in ascending order; a descending view is the same
+    list read backwards, so flipping the sort direction costs nothing.
+
+    A filter narrows the view down to some of the store rows, keeping them in the
+    order of the sort, so sorting and filtering can each change without redoing the
+    other.
+*/
+class TableViewOrder
+{
+public:
+    using RowList = std::shared_ptr<const std::vector<int>>;
+
+    /** Shows the first numRows rows of the store in load order. */
+    void setLoadOrder (int numRows)
+    {
+        sortedRows = nullptr;
+        numRowsLoaded = numRows;
+        reversed = false;
+        updateRowsInView();
+    }
+
+    /** Shows the store rows listed in newSortedRows, optionally from last to first. */
+    void setSortedRows (RowList newSortedRows, bool readBackwards)
+    {
+        jassert (newSortedRows != nullptr);
+
+        sortedRows = std::move (newSortedRows);
+        reversed = readBackwards;
+        updateRowsInView();
+    }
+
+    /** Only shows the store rows listed in matchingRows, which must be in ascending
+        order. A nullptr shows every row again.
+    */
+    void setFilter (RowList matchingRows)
+    {
+        filter = std::move (matchingRows);
+        updateRowsInView();
+    }
+
+    bool isFiltered() const noexcept    { return filter != nullptr; }
+
+    /** Returns the sorted store rows, or nullptr in load order. */
+    RowList getSortedRows() const noexcept  { return sortedRows; }
+    bool isReversed() const noexcept        { return reversed; }
+
+    int getNumRows() const noexcept     { return numRowsInView; }
+
+    /** Returns the store row displayed at a view row, or -1 if it's out of range. */
+    int getStoreRow (int viewRow) const noexcept
+    {
+        if (! juce::isPositiveAndBelow (viewRow, numRowsInView))
+            return -1;
+
+        auto index = reversed ? numRowsInView - 1 - viewRow : viewRow;
+        return rows != nullptr ? (*rows)[(size_t) index] : index;
+    }
+
+    /** Returns the view row that displays a store row, or -1 if it isn't in the view. */
+    int getViewRow (int storeRow) const
+    {
+        if (rows == nullptr)
+            return juce::isPositiveAndBelow (storeRow, numRowsInView) ? storeRow : -1;
+
+        if (storeToView.empty())
+        {
+            storeToView.assign (rows->size(), -1);
+
+            for (int viewRow = 0; viewRow < numRowsInView; ++viewRow)
+            {
+                auto storeRow = getStoreRow (viewRow);
+
+                if ((size_t) storeRow >= storeToView.size())
+                    storeToView.resize ((size_t) storeRow + 1, -1);
+
+                storeToView[(size_t) storeRow] = viewRow;
+            }
+        }
+
+        return juce::isPositiveAndBelow (storeRow, (int) storeToView.size()) ? storeToView[(size_t) storeRow] : -1;
+    }
+
+private:
+    RowList sortedRows, filter;
+    RowList rows;               // the rows in view: the sorted rows that pass the filter
+    int numRowsLoaded = 0, numRowsInView = 0;
+    bool reversed = false;
+    mutable std::vector<int> storeToView;
+
+    void updateRowsInView()
+    {
+        storeToView.clear();
+
+        if (filter == nullptr || sortedRows == nullptr)
+        {
+            // in load order, the filter's ascending store rows are the view already
+            rows = filter != nullptr ? filter : sortedRows;
+            numRowsInView = rows != nullptr ? (int) rows->size() : numRowsLoaded;
+            return;
+        }
+
+        std::vector<bool> passes (sortedRows->size());
+
+        for (auto storeRow : *filter)
+            if ((size_t) storeRow < passes.size())
+                passes[(size_t) storeRow] = true;
+
+        auto filteredRows = std::make_shared<std::vector<int>>();
+        filteredRows->reserve (filter->size());
+
+        for (auto storeRow : *sortedRows)
+            if (passes[(size_t) storeRow])
+                filteredRows->push_back (storeRow);
+
+        rows = std::move (filteredRows);
+        numRowsInView = (int) rows->size();
+    }
+
+    JUCE_LEAK_DETECTOR (TableViewOrder)
+};
+
+//==============================================================================
+/**
+    Remembers the ascending row order of the last few columns that were sorted, so
+    that going back to a recently sorted column doesn't need another sort.
+*/
+class SortOrderCache
+{
+public:
+    TableViewOrder::RowList find (int columnId)
+    {
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->columnId == columnId)
+            {
+                std::rotate (entries.begin(), it, it + 1);
+                return entries.front().rows;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void add (int columnId, TableViewOrder::RowList rows)
+    {
+        invalidateColumn (columnId);
+        entries.insert (entries.begin(), { columnId, std::move (rows) });
+
+        if (entries.size() > maxEntries)
+            entries.pop_back();
+    }
+
+    /** Drops the cached order of a column whose cells have changed. */
+    void invalidateColumn (int columnId)
+    {
+        entries.erase (std::remove_if (entries.begin(), entries.end(),
+                                       [columnId] (const Entry& e) { return e.columnId == columnId; }),
+                       entries.end());
+    }
+
+    void clear()        { entries.clear(); }
+
+private:
+    struct Entry
+    {
+        int columnId;
+        TableViewOrder::RowList rows;
+    };
+
+    static constexpr size_t maxEntries = 4;
+    std::vector<Entry> entries;
+
+    JUCE_LEAK_DETECTOR (SortOrderCache)
+};
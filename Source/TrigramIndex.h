@@ -0,0 +1,192 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    Finds the rows that might contain some text, without reading every row.
+
+    For each run of three bytes (a trigram) found in the cells of a row, the index
+    lists the rows it occurs in, in ascending order. A row can only contain some text
+    if it has every trigram of the text, so intersecting their lists gives a short
+    list of candidates, which then need checking with containsFolded().
+
+    Matching ignores the case of ASCII letters: cells and queries are both folded
+    with fold() before their trigrams are taken. Queries shorter than three bytes
+    have no trigrams, so the index can't narrow them down.
+
+    The index isn't updated when a cell is edited. Instead the edited row is added
+    with addChangedRow(), and is returned as a candidate for every query.
+*/
+class TrigramIndex
+{
+public:
+    /** Indexes some columns, each given as a snapshot of its cells indexed by row.
+        Returns false if shouldExit() asked it to stop before it finished.
+    */
+    bool build (const std::vector<std::vector<juce::String>>& columns, int numRowsToIndex,
+                const std::function<bool()>& shouldExit = {})
+    {
+        postings.clear();
+        changedRows.clear();
+        numRows = numRowsToIndex;
+
+        std::vector<juce::uint32> rowTrigrams;
+
+        for (int row = 0; row < numRows; ++row)
+        {
+            if (shouldExit != nullptr && (row % 4096) == 0 && shouldExit())
+                return false;
+
+            rowTrigrams.clear();
+
+            for (auto& column : columns)
+                addTrigrams (column[(size_t) row], rowTrigrams);
+
+            std::sort (rowTrigrams.begin(), rowTrigrams.end());
+            rowTrigrams.erase (std::unique (rowTrigrams.begin(), rowTrigrams.end()), rowTrigrams.end());
+
+            for (auto trigram : rowTrigrams)
+                postings[trigram].push_back (row);
+        }
+
+        return true;
+    }
+
+    int getNumRows() const noexcept     { return numRows; }
+
+    /** Makes a row a candidate for every query, because its cells have changed since
+        it was indexed.
+    */
+    void addChangedRow (int row)
+    {
+        auto position = std::lower_bound (changedRows.begin(), changedRows.end(), row);
+
+        if (position == changedRows.end() || *position != row)
+            changedRows.insert (position, row);
+    }
+
+    /** Returns the rows that might contain some folded text, in ascending order, or
+        nothing if the text is too short for the index to help.
+    */
+    std::optional<std::vector<int>> getCandidates (const std::string& foldedText) const
+    {
+        if (foldedText.size() < 3)
+            return {};
+
+        std::vector<const std::vector<int>*> lists;
+        std::vector<juce::uint32> queryTrigrams;
+        addFoldedTrigrams (foldedText.data(), foldedText.size(), queryTrigrams);
+
+        std::sort (queryTrigrams.begin(), queryTrigrams.end());
+        queryTrigrams.erase (std::unique (queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+
+        std::vector<int> candidates;
+
+        for (auto trigram : queryTrigrams)
+        {
+            auto list = postings.find (trigram);
+
+            if (list == postings.end())
+            {
+                lists.clear();
+                break;
+            }
+
+            lists.push_back (&list->second);
+        }
+
+        if (! lists.empty())
+        {
+            // starting from the shortest list keeps every intersection small
+            std::sort (lists.begin(), lists.end(), [] (auto* a, auto* b) { return a->size() < b->size(); });
+            candidates = *lists.front();
+
+            for (size_t i = 1; i < lists.size() && ! candidates.empty(); ++i)
+            {
+                std::vector<int> intersection;
+                std::set_intersection (candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(),
+                                       std::back_inserter (intersection));
+                candidates = std::move (intersection);
+            }
+        }
+
+        if (! changedRows.empty())
+        {
+            std::vector<int> merged;
+            std::set_union (candidates.begin(), candidates.end(), changedRows.begin(), changedRows.end(),
+                            std::back_inserter (merged));
+            candidates = std::move (merged);
+        }
+
+        return candidates;
+    }
+
+    /** Returns roughly how much memory the index takes up. */
+    size_t getNumBytesUsed() const noexcept
+    {
+        auto numBytes = changedRows.capacity() * sizeof (int);
+
+        for (auto& [trigram, rows] : postings)
+            numBytes += sizeof (trigram) + sizeof (rows) + 2 * sizeof (void*) + rows.capacity() * sizeof (int);
+
+        return numBytes;
+    }
+
+    //==============================================================================
+    /** Returns the UTF-8 bytes of some text with its ASCII letters in lower case. */
+    static std::string fold (juce::StringRef text)
+    {
+        std::string folded (text.text.getAddress());
+
+        for (auto& c : folded)
+            c = foldByte (c);
+
+        return folded;
+    }
+
+    /** Returns true if a cell contains some text that has already been folded. */
+    static bool containsFolded (juce::StringRef cell, const std::string& foldedText) noexcept
+    {
+        if (foldedText.empty())
+            return true;
+
+        auto* start = cell.text.getAddress();
+        auto* end = start + std::strlen (start);
+
+        return std::search (start, end, foldedText.begin(), foldedText.end(),
+                            [] (char a, char b) { return foldByte (a) == b; }) != end;
+    }
+
+private:
+    std::unordered_map<juce::uint32, std::vector<int>> postings;
+    std::vector<int> changedRows;   // ascending
+    int numRows = 0;
+
+    static char foldByte (char c) noexcept
+    {
+        return (c >= 'A' && c <= 'Z') ? (char) (c + ('a' - 'A')) : c;
+    }
+
+    static void addTrigrams (juce::StringRef text, std::vector<juce::uint32>& trigrams)
+    {
+        auto* t = text.text.getAddress();
+        juce::uint32 window = 0;
+
+        for (size_t i = 0; t[i] != 0; ++i)
+        {
+            window = ((window << 8) | (juce::uint8) foldByte (t[i])) & 0xffffff;
+
+            if (i >= 2)
+                trigrams.push_back (window);
+        }
+    }
+
+    static void addFoldedTrigrams (const char* text, size_t numBytes, std::vector<juce::uint32>& trigrams)
+    {
+        for (size_t i = 2; i < numBytes; ++i)
+            trigrams.push_back (((juce::uint32) (juce::uint8) text[i - 2] << 16)
+                                 | ((juce::uint32) (juce::uint8) text[i - 1] << 8)
+                                 | (juce::uint32) (juce::uint8) text[i]);
+    }
+
+    JUCE_LEAK_DETECTOR (TrigramIndex)
+};
@@ -0,0 +1,401 @@
+#pragma once
+#include <JuceHeader.h>
+#include <clocale>
+#include "TableColumnSchema.h"
+//==============================================================================
+/**
+    The cells of a column with a declared type, kept as native values instead of text:
+    an int32 per row for "int", a double for "float", a packed integer for "version",
+    and a single bit for "bool".
+
+    Every value is handled as a sort key, an unsigned integer in the same order as
+    the values themselves, which is also what SortKeyColumn sorts typed columns by.
+    Versions are up to four dot-separated numbers of up to 32767 each, compared
+    component by component, so "5.10.0" comes after "5.9.1".
+
+    A cell's text is formatted from its value when it's asked for. A cell whose text
+    isn't exactly what that would give back (like "007" in an int column), or that
+    doesn't parse at all, keeps its original text on the side, so no cell ever reads
+    back differently from how it was written. Cells that don't parse have no value:
+    their sort key is 0, which puts them before all the others.
+*/
+class TypedColumn
+{
+public:
+    using ColumnType = TableColumnSchema::ColumnType;
+
+    explicit TypedColumn (ColumnType columnType)
+        : type (columnType)
+    {
+        jassert (type != ColumnType::text);
+    }
+
+    int getNumRows() const noexcept     { return numRows; }
+
+    void reserve (int numRowsExpected)
+    {
+        const auto numWords = (size_t) (numRowsExpected + 63) / 64;
+        missingBits.reserve (numWords);
+
+        switch (type)
+        {
+            case ColumnType::integer:   integers.reserve ((size_t) numRowsExpected); break;
+            case ColumnType::decimal:   decimals.reserve ((size_t) numRowsExpected); break;
+            case ColumnType::version:   versions.reserve ((size_t) numRowsExpected); break;
+            case ColumnType::boolean:   booleanBits.reserve (numWords); break;
+            case ColumnType::text:      break;
+        }
+    }
+
+    void append (juce::StringRef text)
+    {
+        const auto row = numRows++;
+
+        if (((size_t) row % 64) == 0)
+        {
+            missingBits.push_back (0);
+
+            if (type == ColumnType::boolean)
+                booleanBits.push_back (0);
+        }
+
+        switch (type)
+        {
+            case ColumnType::integer:   integers.push_back (0); break;
+            case ColumnType::decimal:   decimals.push_back (0.0); break;
+            case ColumnType::version:   versions.push_back (0); break;
+            case ColumnType::boolean:
+            case ColumnType::text:      break;
+        }
+
+        set (row, text);
+    }
+
+    void set (int row, juce::StringRef text)
+    {
+        if (! juce::isPositiveAndBelow (row, numRows))
+            return;
+
+        const auto key = getSortKey (type, text);
+        setKey (row, key);
+
+        if (key != 0 && format (type, key) == text)
+            irregularTexts.erase (row);
+        else if (text.isNotEmpty())
+            irregularTexts[row] = juce::String (text);
+        else
+            irregularTexts.erase (row);
+    }
+
+    juce::String getText (int row) const
+    {
+        if (! juce::isPositiveAndBelow (row, numRows))
+            return {};
+
+        if (! irregularTexts.empty())
+            if (auto irregular = irregularTexts.find (row); irregular != irregularTexts.end())
+                return irregular->second;
+
+        auto key = getSortKey (row);
+        return key != 0 ? format (type, key) : juce::String();
+    }
+
+    /** Returns the sort key of a row's value, or 0 if it doesn't have one. */
+    juce::uint64 getSortKey (int row) const noexcept
+    {
+        if (! juce::isPositiveAndBelow (row, numRows) || getBit (missingBits, row))
+            return 0;
+
+        switch (type)
+        {
+            case ColumnType::integer:   return (juce::uint64) ((juce::int64) integers[(size_t) row] - std::numeric_limits<juce::int32>::min()) + 1;
+            case ColumnType::decimal:   return decimalToKey (decimals[(size_t) row]);
+            case ColumnType::version:   return versions[(size_t) row] + 1;
+            case ColumnType::boolean:   return getBit (booleanBits, row) ? 2 : 1;
+            case ColumnType::text:      break;
+        }
+
+        return 0;
+    }
+
+    bool getBoolean (int row) const noexcept
+    {
+        return getSortKey (row) == 2;
+    }
+
+    /** Returns roughly how much memory the column takes up. */
+    size_t getNumBytesUsed() const noexcept
+    {
+        auto numBytes = integers.capacity() * sizeof (juce::int32) + decimals.capacity() * sizeof (double)
+                      + versions.capacity() * sizeof (juce::uint64)
+                      + (booleanBits.capacity() + missingBits.capacity()) * sizeof (juce::uint64);
+
+        for (auto& [row, text] : irregularTexts)
+            numBytes += sizeof (row) + sizeof (text) + text.getNumBytesAsUTF8() + 1;
+
+        return numBytes;
+    }
+
+    //==============================================================================
+    /** Parses some text as a value of the given type, returning its sort key, or 0 if it
+        isn't a valid value.
+    */
+    static juce::uint64 getSortKey (ColumnType columnType, juce::StringRef text)
+    {
+        auto* t = text.text.getAddress();
+
+        switch (columnType)
+        {
+            case ColumnType::integer:
+            {
+                juce::int64 value = 0;
+
+                if (! parseInteger (t, value) || *t != 0
+                     || value < std::numeric_limits<juce::int32>::min() || value > std::numeric_limits<juce::int32>::max())
+                    return 0;
+
+                return (juce::uint64) (value - std::numeric_limits<juce::int32>::min()) + 1;
+            }
+
+            case ColumnType::decimal:
+            {
+                if (! isDecimal (t))
+                    return 0;
+
+                auto value = text.text.getDoubleValue();
+                return std::isfinite (value) ? decimalToKey (value) : 0;
+            }
+
+            case ColumnType::boolean:
+            {
+                if (text == "1" || juce::String (text).equalsIgnoreCase ("true"))   return 2;
+                if (text == "0" || juce::String (text).equalsIgnoreCase ("false"))  return 1;
+                return 0;
+            }
+
+            case ColumnType::version:
+            {
+                juce::uint64 packed = 0;
+                int numComponents = 0;
+
+                for (;;)
+                {
+                    juce::int64 component = 0;
+
+                    if (*t == '-' || ! parseInteger (t, component) || component > maxVersionComponent
+                         || ++numComponents > maxVersionComponents)
+                        return 0;
+
+                    packed |= (juce::uint64) component << getVersionShift (numComponents - 1);
+
+                    if (*t == 0)
+                        return (packed | (juce::uint64) (numComponents - 1)) + 1;
+
+                    if (*t++ != '.')
+                        return 0;
+                }
+            }
+
+            case ColumnType::text:
+                break;
+        }
+
+        return 0;
+    }
+
+    /** Formats the value of a non-zero sort key as text. */
+    static juce::String format (ColumnType columnType, juce::uint64 key)
+    {
+        jassert (key != 0);
+
+        switch (columnType)
+        {
+            case ColumnType::integer:   return juce::String ((juce::int64) (key - 1) + std::numeric_limits<juce::int32>::min());
+            case ColumnType::decimal:   return formatDecimal (keyToDecimal (key));
+            case ColumnType::boolean:   return key == 2 ? "1" : "0";
+
+            case ColumnType::version:
+            {
+                const auto packed = key - 1;
+                const auto numComponents = (int) (packed & 3) + 1;
+                juce::String text;
+
+                for (int i = 0; i < numComponents; ++i)
+                {
+                    if (i > 0)
+                        text << '.';
+
+                    text << (int) ((packed >> getVersionShift (i)) & maxVersionComponent);
+                }
+
+                return text;
+            }
+
+            case ColumnType::text:
+                break;
+        }
+
+        return {};
+    }
+
+private:
+    static constexpr int maxVersionComponents = 4;
+    static constexpr juce::int64 maxVersionComponent = 0x7fff;
+
+    ColumnType type;
+    int numRows = 0;
+
+    std::vector<juce::int32> integers;
+    std::vector<double> decimals;
+    std::vector<juce::uint64> versions;     // packed, as in their sort keys
+    std::vector<juce::uint64> booleanBits, missingBits;
+    std::unordered_map<int, juce::String> irregularTexts;
+
+    void setKey (int row, juce::uint64 key) noexcept
+    {
+        setBit (missingBits, row, key == 0);
+
+        switch (type)
+        {
+            case ColumnType::integer:   integers[(size_t) row] = key != 0 ? (juce::int32) ((juce::int64) (key - 1) + std::numeric_limits<juce::int32>::min()) : 0; break;
+            case ColumnType::decimal:   decimals[(size_t) row] = key != 0 ? keyToDecimal (key) : 0.0; break;
+            case ColumnType::version:   versions[(size_t) row] = key != 0 ? key - 1 : 0; break;
+            case ColumnType::boolean:   setBit (booleanBits, row, key == 2); break;
+            case ColumnType::text:      break;
+        }
+    }
+
+    static bool getBit (const std::vector<juce::uint64>& bits, int index) noexcept
+    {
+        return ((bits[(size_t) index / 64] >> ((size_t) index % 64)) & 1) != 0;
+    }
+
+    static void setBit (std::vector<juce::uint64>& bits, int index, bool shouldBeSet) noexcept
+    {
+        const auto mask = (juce::uint64) 1 << ((size_t) index % 64);
+        auto& word = bits[(size_t) index / 64];
+        word = shouldBeSet ? (word | mask) : (word & ~mask);
+    }
+
+    /** Versions keep their first component in the top bits, and how many components
+        they had in the bottom two.
+    */
+    static int getVersionShift (int componentIndex) noexcept
+    {
+        return 2 + 15 * (maxVersionComponents - 1 - componentIndex);
+    }
+
+    /** Reads an optional minus sign and at least one digit, leaving t after them. */
+    static bool parseInteger (const char*& t, juce::int64& value)
+    {
+        const auto isNegative = *t == '-';
+
+        if (isNegative)
+            ++t;
+
+        if (*t < '0' || *t > '9')
+            return false;
+
+        value = 0;
+
+        while (*t >= '0' && *t <= '9')
+        {
+            if (value > std::numeric_limits<juce::int32>::max())
+                return false;   // too big for any of our types, so don't risk overflowing
+
+            value = value * 10 + (*t++ - '0');
+        }
+
+        if (isNegative)
+            value = -value;
+
+        return true;
+    }
+
+    /** Checks for [-]digits[.digits][e[-]digits], with at least one digit before the exponent. */
+    static bool isDecimal (const char* t) noexcept
+    {
+        auto skipDigits = [&t]
+        {
+            auto start = t;
+
+            while (*t >= '0' && *t <= '9')
+                ++t;
+
+            return t > start;
+        };
+
+        if (*t == '-' || *t == '+')
+            ++t;
+
+        auto hasDigits = skipDigits();
+
+        if (*t == '.')
+        {
+            ++t;
+            hasDigits = skipDigits() || hasDigits;
+        }
+
+        if (! hasDigits)
+            return false;
+
+        if (*t == 'e' || *t == 'E')
+        {
+            ++t;
+
+            if (*t == '-' || *t == '+')
+                ++t;
+
+            if (! skipDigits())
+                return false;
+        }
+
+        return *t == 0;
+    }
+
+    /** Maps a double to an unsigned integer that sorts in the same order. Finite values
+        never map to 0.
+    */
+    static juce::uint64 decimalToKey (double value) noexcept
+    {
+        juce::uint64 bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        return (bits >> 63) != 0 ? ~bits : (bits | ((juce::uint64) 1 << 63));
+    }
+
+    static double keyToDecimal (juce::uint64 key) noexcept
+    {
+        auto bits = (key >> 63) != 0 ? (key & ~((juce::uint64) 1 << 63)) : ~key;
+        double value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+
+    /** Formats a double with as few significant digits as will read back as the same
+        value, so that "0.1" stays "0.1" and doesn't need keeping as irregular text.
+        The text always has a '.' for its decimal point, whatever the C locale's is.
+    */
+    static juce::String formatDecimal (double value)
+    {
+        const auto localeDecimalPoint = *std::localeconv()->decimal_point;
+        char buffer[32] = {};
+
+        for (int precision = 1; precision <= 17; ++precision)
+        {
+            std::snprintf (buffer, sizeof (buffer), "%.*g", precision, value);
+
+            if (localeDecimalPoint != '.')
+                std::replace (std::begin (buffer), std::end (buffer), localeDecimalPoint, '.');
+
+            // read back as getDoubleValue() reads the cells, which ignores the locale too
+            juce::CharPointer_UTF8 text (buffer);
+
+            if (juce::CharacterFunctions::readDoubleValue (text) == value)
+                break;
+        }
+
+        return buffer;
+    }
+
+    JUCE_LEAK_DETECTOR (TypedColumn)
+};
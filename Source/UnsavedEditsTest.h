@@ -0,0 +1,84 @@
+#pragma once
+#include <JuceHeader.h>
+#include "PropertyWindow.h"
+#include "SyntheticTable.h"
+//==============================================================================
+/**
+    Checks that an edit that was never saved stays unsaved from one launch to the
+    next: a cell is edited and the table closed without saving, and then it's opened
+    twice more. Each time the edit has to come back from the journal and still be
+    known as unsaved, and the snapshot the first launch wrote mustn't have it in.
+
+    The component loads and snapshots on other threads and hands the results back
+    through the message loop, so this runs in ValuePropertyWndBenchmarks, with
+    "--run-tests".
+*/
+class UnsavedEditsTest  : public juce::UnitTest
+{
+public:
+    UnsavedEditsTest()  : juce::UnitTest ("Unsaved edits", "Journal") {}
+
+    void runTest() override
+    {
+        static constexpr int idColumnId = 1, nameColumnId = 3;
+        const juce::String editedText ("edited but not saved");
+
+        juce::TemporaryFile tableFile (".xml");
+        const auto snapshotFile = TableSnapshot::getFileFor (tableFile.getFile());
+        const auto journalFile = TableJournal::getFileFor (tableFile.getFile());
+
+        SyntheticTable::Options options;
+        options.numRows = 1000;
+        expect (SyntheticTable::write (tableFile.getFile(), options));
+
+        juce::String editedId;
+
+        beginTest ("Editing a cell and closing without saving");
+        {
+            PropertyWndComponent component (tableFile.getFile());
+            waitUntilIdle (component);
+
+            editedId = component.getText (idColumnId, 0);
+            component.setText (nameColumnId, 0, editedText);
+
+            expect (component.isCellUnsaved (nameColumnId, 0));
+            waitUntilIdle (component);
+        }
+
+        expect (journalFile.existsAsFile());
+        expect (snapshotFile.existsAsFile());
+
+        if (auto snapshot = TableSnapshot::open (snapshotFile, tableFile.getFile()))
+            for (int row = 0; row < snapshot->getNumRows(); ++row)
+                expect (snapshot->getCell (row, snapshot->getSchema().getSlotForName ("Name")) != editedText);
+
+        for (int launch = 2; launch <= 3; ++launch)
+        {
+            beginTest ("Opening the table again, launch " + juce::String (launch));
+
+            PropertyWndComponent component (tableFile.getFile());
+            waitUntilIdle (component);
+
+            expectEquals (component.getText (idColumnId, 0), editedId);
+            expectEquals (component.getText (nameColumnId, 0), editedText);
+            expect (component.isCellUnsaved (nameColumnId, 0));
+            expect (! component.isCellUnsaved (nameColumnId, 1));
+        }
+
+        snapshotFile.deleteFile();
+        journalFile.deleteFile();
+    }
+
+private:
+    /** Runs the message loop until the component has nothing left to do, and then for
+        one more turn, so that the results its background jobs posted get delivered.
+    */
+    static void waitUntilIdle (const PropertyWndComponent& component)
+    {
+        for (int numIdlePolls = 0; numIdlePolls < 2;)
+        {
+            juce::MessageManager::getInstance()->runDispatchLoopUntil (20);
+            numIdlePolls = component.isBusy() ? 0 : numIdlePolls + 1;
+        }
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <JuceHeader.h>
+//==============================================================================
+/**
+    The threads shared by every parallel job in the app, such as sorting and loading.
+    They are created by the first juce::SharedResourcePointer<WorkerThreads> and
+    stopped when the last one goes away, so keep one alive for as long as parallel
+    work may happen.
+*/
+struct WorkerThreads
+{
+    juce::ThreadPool pool { juce::jmax (1, juce::SystemStats::getNumCpus() - 1) };
+
+    /** Calls task (0 ... numTasks - 1), running task 0 on the calling thread, and
+        returns once all of them have finished.
+    */
+    template <typename Task>
+    void runTasks (int numTasks, Task&& task)
+    {
+        std::atomic<int> numRemaining { numTasks };
+        juce::WaitableEvent allDone;
+
+        auto runTask = [&] (int index)
+        {
+            task (index);
+
+            if (--numRemaining == 0)
+                allDone.signal();
+        };
+
+        for (int i = 1; i < numTasks; ++i)
+            pool.addJob ([&runTask, i] { runTask (i); });
+
+        runTask (0);
+        allDone.wait();
+    }
+};